@@ -0,0 +1,241 @@
+// Header with CSVAppender class.
+
+#ifndef CSV_MANAGER_CSV_APPENDER
+#define CSV_MANAGER_CSV_APPENDER
+
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <numeric>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+
+#include "./csv_data.hpp"
+
+
+namespace csvm {
+
+
+class CSVAppender {
+/* Appends rows from many producer threads to one CSVData object.
+ *
+ * Every producer takes its own Buffer with .buffer() and adds rows into it without any synchronization.
+ * When a Buffer holds batch_size rows, it hands them over to the appender, which moves them into the output under a lock.
+ * So producers contend only at batch boundaries. A Buffer also hands over its rows on .flush() and on destruction.
+ *
+ * If the appender is ordered, every row must be added with a key. Batches are kept pending, and .close() moves them
+ * into the output sorted by key. Rows with equal keys keep the order in which they were handed over.
+ *
+ * After .close() the appender takes no more rows. A Buffer may outlive it: adding or flushing rows then raises
+ * std::logic_error, and rows left in the Buffer are dropped on its destruction.
+ *
+ * The columns of the output must not change, and the output must not be accessed, until the appender is closed.
+ */
+public:
+
+    // Type aliases.
+    using vector_s = std::vector<std::string>;
+    using vector_v_s = std::vector<vector_s>;
+    using size_type = vector_v_s::size_type;
+    using key_type = std::uint64_t;
+
+
+    // Member classes.
+
+
+    struct State {
+    // The state shared by the appender and its buffers. It lives as long as any of them.
+        State(CSVData& output, size_type batch_size, bool ordered) : output{&output},
+              column_number{output.column_number()}, batch_size{batch_size ? batch_size : 1}, ordered{ordered} {}
+
+        // The output, its number of columns and the settings.
+        CSVData* output;
+        const size_type column_number;
+        const size_type batch_size;
+        const bool ordered;
+
+        // The lock for the output, pending rows and the open flag. The flag is cleared by .close().
+        std::mutex mutex;
+        std::atomic<bool> open{true};
+
+        // Rows and keys which wait for .close() in the ordered mode.
+        vector_v_s pending_rows;
+        std::vector<key_type> pending_keys;
+
+
+        bool take(vector_v_s& rows, std::vector<key_type>& keys) {
+            // Moves a batch of rows into the output, or into pending rows if ordered. Returns false if closed.
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!open)
+                return false;
+
+            auto& target = ordered ? pending_rows : output->get_values();
+            std::move(rows.begin(), rows.end(), std::back_inserter(target));
+
+            if (ordered)
+                pending_keys.insert(pending_keys.end(), keys.begin(), keys.end());
+
+            rows.clear();
+            keys.clear();
+            return true;
+        }
+    };
+
+
+    class Buffer {
+    // Rows of one producer. Should be used only from one thread.
+    public:
+
+        Buffer(std::shared_ptr<State> state) : state{std::move(state)} {
+            rows.reserve(this->state->batch_size);
+        }
+
+        Buffer(Buffer&& other) : state{std::move(other.state)}, rows{std::move(other.rows)}, keys{std::move(other.keys)} {}
+
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+
+        ~Buffer() {
+            // Hands over the rest of rows, or drops them if the appender is closed.
+            if (state && !rows.empty())
+                state->take(rows, keys);
+        }
+
+
+        Buffer& add_row(vector_s row) {
+            // Adds a row. Raises std::invalid_argument if the size of the row is invalid or the appender is ordered.
+            check_open();
+            if (state->ordered)
+                throw std::invalid_argument("The ordered appender requires a key for every row.");
+
+            return push(std::move(row));
+        }
+
+        Buffer& add_row(key_type key, vector_s row) {
+            // Adds a row with the ordering key. The key is ignored if the appender isn't ordered.
+            check_open();
+            if (state->ordered)
+                keys.push_back(key);
+
+            return push(std::move(row));
+        }
+
+
+        Buffer& flush() {
+            // Hands over all the rows to the appender. Raises std::logic_error if the appender is closed.
+            check_open();
+            if (!rows.empty() && !state->take(rows, keys))
+                throw std::logic_error("The appender is closed, " + std::to_string(rows.size()) + " rows can't be handed over.");
+            return *this;
+        }
+
+
+    private:
+        // The shared state and buffered rows with their keys.
+        std::shared_ptr<State> state;
+        vector_v_s rows;
+        std::vector<key_type> keys;
+
+
+        Buffer& push(vector_s&& row) {
+            // Validates and adds a row. Hands over the batch if it's full.
+            if (row.size() != state->column_number) {
+                if (state->ordered)
+                    keys.pop_back();
+                throw std::invalid_argument("The row size \"" + std::to_string(row.size()) + "\" is invalid.");
+            }
+
+            rows.push_back(std::move(row));
+
+            if (rows.size() >= state->batch_size)
+                flush();
+
+            return *this;
+        }
+
+        void check_open() const {
+            // Raises std::logic_error if the buffer was moved from or the appender is closed.
+            if (!state || !state->open)
+                throw std::logic_error("The appender of the buffer is closed.");
+        }
+    };
+
+
+    // Attributes and methods.
+
+
+    CSVAppender(CSVData& output, size_type batch_size = 4096, bool ordered = false)
+               : state{std::make_shared<State>(output, batch_size, ordered)} {
+        /* CSVAppender constructor.
+         * Arguments:
+         *     output: The CSVData object to which rows will be appended. Its columns must already be set.
+         *     batch_size: Number of rows which Buffer collects before handing them over.
+         *     ordered: If true, rows are added with keys and placed into the output sorted by them on .close().
+         */
+    }
+
+    CSVAppender(const CSVAppender&) = delete;
+    CSVAppender& operator=(const CSVAppender&) = delete;
+
+    ~CSVAppender() {
+        close();
+    }
+
+
+    Buffer buffer() {
+        // Creates a new Buffer for one producer.
+        return Buffer(state);
+    }
+
+
+    CSVAppender& close() {
+        /* Moves pending rows of the ordered appender into the output and stops taking rows.
+         * Buffers must be flushed before this call, rows handed over later are rejected.
+         */
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->open = false;
+
+        auto& pending_rows = state->pending_rows;
+        auto& pending_keys = state->pending_keys;
+        if (pending_rows.empty())
+            return *this;
+
+        std::vector<size_type> order(pending_rows.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&pending_keys](size_type left, size_type right) {
+            return pending_keys[left] < pending_keys[right];
+        });
+
+        auto& values = state->output->get_values();
+        values.reserve(values.size() + order.size());
+        for (auto i : order)
+            values.push_back(std::move(pending_rows[i]));
+
+        pending_rows.clear();
+        pending_keys.clear();
+
+        return *this;
+    }
+
+
+    bool is_open() const {
+        // Checks if the appender still takes rows.
+        return state->open;
+    }
+
+
+private:
+    // The state shared with buffers.
+    std::shared_ptr<State> state;
+};
+
+
+}
+
+
+#endif
@@ -0,0 +1,579 @@
+// Header with CSVArrow class.
+
+#ifndef CSV_MANAGER_CSV_ARROW
+#define CSV_MANAGER_CSV_ARROW
+
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <fstream>
+#include <ostream>
+#include <stdexcept>
+
+#include "./csv_data.hpp"
+
+
+// Structures of the Arrow C data interface, copied from the Arrow specification.
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+extern "C" {
+
+struct ArrowSchema {
+    // Array type description
+    const char* format;
+    const char* name;
+    const char* metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema** children;
+    struct ArrowSchema* dictionary;
+
+    // Release callback
+    void (*release)(struct ArrowSchema*);
+    // Opaque producer-specific data
+    void* private_data;
+};
+
+struct ArrowArray {
+    // Array data description
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void** buffers;
+    struct ArrowArray** children;
+    struct ArrowArray* dictionary;
+
+    // Release callback
+    void (*release)(struct ArrowArray*);
+    // Opaque producer-specific data
+    void* private_data;
+};
+
+}
+
+#endif
+
+
+namespace csvm {
+
+
+class CSVArrow {
+/* Converts CSVData to and from the Apache Arrow columnar layout.
+ *
+ * Every column becomes an Arrow utf8 array: a validity bitmap (LSB first, 1 means valid), 32-bit offsets (row number + 1)
+ * and a data buffer with all field bytes of the column. Columns with more than 2 GiB of data, or all columns if large_utf8 is true,
+ * become large utf8 arrays with 64-bit offsets.
+ * The table is exported and imported through the Arrow C data interface as a struct array with one utf8 child per column,
+ * so Arrow implementations in the same process can take the buffers without copying or parsing them.
+ * For other processes and tools, .write_ipc() and .save_ipc() write the table as one record batch in the Arrow IPC stream
+ * or file (Feather v2) format. The metadata flatbuffers are written by hand, for little-endian hosts only.
+ *
+ * CSV has no nulls, so all fields are valid and the bitmap is omitted, unless empty_as_null is true, in which case
+ * empty fields are exported as nulls. Nulls are imported as empty fields.
+ */
+public:
+
+    // Type aliases.
+    using vector_s = std::vector<std::string>;
+    using vector_v_s = std::vector<vector_s>;
+    using size_type = vector_v_s::size_type;
+
+
+    // Member classes.
+
+
+    struct Column {
+    // Buffers of one utf8 column. Large utf8 columns have large_offsets instead of offsets.
+        std::string name;
+        std::vector<std::uint8_t> validity;
+        std::vector<std::int32_t> offsets;
+        std::vector<std::int64_t> large_offsets;
+        std::string data;
+        std::int64_t null_count = 0;
+
+        bool large() const {
+            return !large_offsets.empty();
+        }
+
+        const void* offsets_data() const {
+            return large() ? static_cast<const void*>(large_offsets.data()) : offsets.data();
+        }
+
+        size_type offsets_size() const {
+            // The size of the offsets buffer in bytes.
+            return large() ? large_offsets.size() * sizeof(std::int64_t) : offsets.size() * sizeof(std::int32_t);
+        }
+    };
+
+
+    // Methods.
+
+
+    static std::vector<Column> to_columns(CSVData& data, bool empty_as_null = false, bool large_utf8 = false) {
+        // Builds buffers of all the columns. Columns which don't fit into 32-bit offsets get 64-bit ones.
+        auto names = data.get_column_names();
+        auto& values = data.get_values();
+        std::vector<Column> output(names.size());
+
+        for (size_type c = 0; c < names.size(); ++c) {
+            auto& column = output[c];
+            column.name = names[c];
+
+            size_type size = 0;
+            for (auto& row : values)
+                size += row[c].size();
+            bool large = large_utf8 || size > static_cast<size_type>(std::numeric_limits<std::int32_t>::max());
+
+            column.data.reserve(size);
+            if (large) {
+                column.large_offsets.reserve(values.size() + 1);
+                column.large_offsets.push_back(0);
+            }
+            else {
+                column.offsets.reserve(values.size() + 1);
+                column.offsets.push_back(0);
+            }
+            for (auto& row : values) {
+                column.data += row[c];
+                if (large)
+                    column.large_offsets.push_back(column.data.size());
+                else
+                    column.offsets.push_back(column.data.size());
+            }
+
+            if (empty_as_null) {
+                column.validity.assign((values.size() + 7) / 8, 0);
+                for (size_type r = 0; r < values.size(); ++r) {
+                    if (values[r][c].empty())
+                        ++column.null_count;
+                    else
+                        column.validity[r / 8] |= 1 << (r % 8);
+                }
+                if (!column.null_count)
+                    column.validity.clear();
+            }
+        }
+
+        return output;
+    }
+
+
+    static void export_table(CSVData& data, ArrowArray* array, ArrowSchema* schema, bool empty_as_null = false, bool large_utf8 = false) {
+        // Fills the given C data interface structures with the content of data. The consumer must call their release callbacks.
+        auto columns = to_columns(data, empty_as_null, large_utf8);
+
+        auto* schema_data = new SchemaData{"+s", "", {}, {}};
+        auto* array_data = new ArrayData;
+        schema_data->children_storage.resize(columns.size());
+        array_data->children_storage.resize(columns.size());
+
+        for (size_type i = 0; i < columns.size(); ++i) {
+            auto& child_schema = schema_data->children_storage[i];
+            auto* child_schema_data = new SchemaData{columns[i].large() ? "U" : "u", columns[i].name, {}, {}};
+            fill_schema(child_schema, child_schema_data);
+            child_schema.flags = ARROW_FLAG_NULLABLE;
+            schema_data->children.push_back(&child_schema);
+
+            auto& child_array = array_data->children_storage[i];
+            auto* child_array_data = new ArrayData;
+            child_array_data->column = std::move(columns[i]);
+            auto& column = child_array_data->column;
+            child_array_data->buffers = {column.validity.empty() ? nullptr : column.validity.data(),
+                                         column.offsets_data(), column.data.data()};
+            fill_array(child_array, child_array_data, data.row_number(), column.null_count);
+            array_data->children.push_back(&child_array);
+        }
+
+        array_data->buffers = {nullptr};
+        fill_schema(*schema, schema_data);
+        fill_array(*array, array_data, data.row_number(), 0);
+    }
+
+
+    static void import_table(CSVData& data, ArrowArray* array, ArrowSchema* schema) {
+        // Replaces content of data with the struct array of utf8 or large utf8 columns and releases the structures.
+        // Raises std::invalid_argument if the array has an unsupported type or column names repeat, and then data isn't changed.
+        try {
+            read_table(data, array, schema);
+        }
+        catch (...) {
+            release(array, schema);
+            throw;
+        }
+        release(array, schema);
+    }
+
+
+    template <typename Sink> static void write_ipc(CSVData& data, Sink& sink, bool file_format = false, bool empty_as_null = false,
+                                                   bool large_utf8 = false) {
+        /* Writes the table into the sink (see "csv_sink.hpp") in the Arrow IPC stream format: the schema message, one record batch
+         * and the end-of-stream marker. If file_format is true, writes the Arrow IPC file format, which also has magic strings
+         * and the footer, so it can be opened as a Feather v2 file. Other arguments are the same as in .to_columns().
+         */
+        auto columns = to_columns(data, empty_as_null, large_utf8);
+        std::int64_t rows = data.row_number();
+        std::int64_t position = 0;
+        auto put = [&sink, &position](const std::string& bytes) {
+            sink.write(bytes.data(), bytes.size());
+            position += bytes.size();
+        };
+
+        if (file_format)
+            put(std::string(file_magic, 6) + std::string(2, '\0'));
+
+        put(message(1, 0, [&columns](FlatBuffer& flat) {
+            return write_schema(flat, columns);
+        }));
+
+        // Buffers of the body with their offsets and sizes. Every buffer starts at a multiple of 8 bytes.
+        std::vector<std::pair<const void*, std::int64_t>> buffers;
+        for (auto& column : columns) {
+            buffers.push_back({column.validity.data(), column.null_count ? column.validity.size() : 0});
+            buffers.push_back({column.offsets_data(), column.offsets_size()});
+            buffers.push_back({column.data.data(), column.data.size()});
+        }
+        std::int64_t body_size = 0;
+        for (auto& buffer : buffers)
+            body_size += padded(buffer.second);
+
+        auto batch = message(3, body_size, [&columns, &buffers, rows](FlatBuffer& flat) {
+            auto table = flat.table({8, 4, 4});
+            flat.set<std::int64_t>(table[1], rows);
+
+            auto nodes = flat.vector(columns.size(), 16, 8);
+            flat.link(table[2], nodes);
+            for (size_type i = 0; i < columns.size(); ++i) {
+                flat.set<std::int64_t>(nodes + 4 + 16 * i, rows);
+                flat.set<std::int64_t>(nodes + 12 + 16 * i, columns[i].null_count);
+            }
+
+            auto vector = flat.vector(buffers.size(), 16, 8);
+            flat.link(table[3], vector);
+            std::int64_t offset = 0;
+            for (size_type i = 0; i < buffers.size(); ++i) {
+                flat.set<std::int64_t>(vector + 4 + 16 * i, offset);
+                flat.set<std::int64_t>(vector + 12 + 16 * i, buffers[i].second);
+                offset += padded(buffers[i].second);
+            }
+            return table[0];
+        });
+        std::int64_t batch_position = position;
+        std::int32_t batch_size = batch.size();
+        put(batch);
+
+        const char padding[8] = {};
+        for (auto& buffer : buffers) {
+            sink.write(static_cast<const char*>(buffer.first), buffer.second);
+            sink.write(padding, padded(buffer.second) - buffer.second);
+            position += padded(buffer.second);
+        }
+
+        put(std::string(4, '\xFF') + std::string(4, '\0'));
+        if (!file_format)
+            return;
+
+        // The footer repeats the schema and points to the record batch.
+        FlatBuffer flat;
+        auto footer = flat.table({2, 4, 4, 4});
+        flat.link(0, footer[0]);
+        flat.set<std::int16_t>(footer[1], metadata_version);
+        flat.link(footer[2], write_schema(flat, columns));
+        flat.link(footer[3], flat.vector(0, 24, 8));
+        auto blocks = flat.vector(1, 24, 8);
+        flat.link(footer[4], blocks);
+        flat.set<std::int64_t>(blocks + 4, batch_position);
+        flat.set<std::int32_t>(blocks + 12, batch_size);
+        flat.set<std::int64_t>(blocks + 20, body_size);
+
+        std::int32_t footer_size = flat.bytes.size();
+        put(flat.bytes + std::string(reinterpret_cast<const char*>(&footer_size), 4) + std::string(file_magic, 6));
+    }
+
+
+    static void save_ipc(CSVData& data, const std::string& path, bool file_format = true, bool empty_as_null = false,
+                         bool large_utf8 = false) {
+        // Writes the table into the file in the Arrow IPC file format, or the stream format if file_format is false.
+        // Raises std::runtime_error if the file can't be written.
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        StreamSink sink{file};
+        write_ipc(data, sink, file_format, empty_as_null, large_utf8);
+        if (!file.flush())
+            throw std::runtime_error("Can't write the file \"" + path + "\".");
+    }
+
+
+private:
+
+    // Magic string of Arrow IPC files, and the metadata version V5.
+    static constexpr char file_magic[7] = "ARROW1";
+    static constexpr std::int16_t metadata_version = 4;
+
+
+    struct StreamSink {
+    // Passes written bytes to the output stream.
+        std::ostream& output;
+
+        void write(const char* data, size_type size) {
+            output.write(data, size);
+        }
+    };
+
+
+    class FlatBuffer {
+    // Writes a flatbuffer front to back. Tables are written after their vtables, and objects which fields point to are written
+    // after the tables, so all offsets are positive. Positions are offsets from the start of the buffer, which must be 8-byte aligned.
+    public:
+        std::string bytes;
+
+        FlatBuffer() {
+            // The offset of the root table, which is set by .link(0, root).
+            put<std::uint32_t>(0);
+        }
+
+        void pad(size_type alignment) {
+            bytes.resize((bytes.size() + alignment - 1) / alignment * alignment, '\0');
+        }
+
+        template <typename T> size_type put(T value) {
+            pad(sizeof(T));
+            auto at = bytes.size();
+            bytes.append(reinterpret_cast<const char*>(&value), sizeof(T));
+            return at;
+        }
+
+        template <typename T> void set(size_type at, T value) {
+            std::memcpy(&bytes[at], &value, sizeof(T));
+        }
+
+        void link(size_type at, size_type object) {
+            // Points the offset field at the position to the object after it.
+            set<std::uint32_t>(at, object - at);
+        }
+
+        std::vector<size_type> table(const std::vector<size_type>& sizes) {
+            // Writes a table with zeroed fields of the given sizes, 0 for absent fields.
+            // Returns the position of the table, and then positions of its fields, 0 for absent ones.
+            auto vtable = put<std::uint16_t>(4 + 2 * sizes.size());
+            put<std::uint16_t>(0);
+            for (size_type i = 0; i < sizes.size(); ++i)
+                put<std::uint16_t>(0);
+
+            auto table = put<std::int32_t>(0);
+            set<std::int32_t>(table, table - vtable);
+            std::vector<size_type> output = {table};
+            for (size_type i = 0; i < sizes.size(); ++i) {
+                if (!sizes[i]) {
+                    output.push_back(0);
+                    continue;
+                }
+                pad(sizes[i]);
+                output.push_back(bytes.size());
+                set<std::uint16_t>(vtable + 4 + 2 * i, bytes.size() - table);
+                bytes.append(sizes[i], '\0');
+            }
+            set<std::uint16_t>(vtable + 2, bytes.size() - table);
+            return output;
+        }
+
+        size_type string(const std::string& value) {
+            auto at = put<std::uint32_t>(value.size());
+            bytes += value;
+            bytes += '\0';
+            return at;
+        }
+
+        size_type vector(size_type count, size_type element_size, size_type alignment = 4) {
+            // Writes a vector of zeroed elements, aligned to the alignment, and returns its position. Elements start 4 bytes after it.
+            pad(4);
+            while ((bytes.size() + 4) % alignment)
+                bytes += '\0';
+            auto at = put<std::uint32_t>(count);
+            bytes.append(count * element_size, '\0');
+            return at;
+        }
+    };
+
+
+    static std::int64_t padded(std::int64_t size) {
+        return (size + 7) / 8 * 8;
+    }
+
+
+    static size_type write_schema(FlatBuffer& flat, const std::vector<Column>& columns) {
+        // Writes the Schema table with a nullable utf8 or large utf8 field for every column, and returns its position.
+        auto schema = flat.table({2, 4});
+        auto fields = flat.vector(columns.size(), 4);
+        flat.link(schema[2], fields);
+
+        for (size_type i = 0; i < columns.size(); ++i) {
+            // Fields: name, nullable, type type, type, dictionary, children. Types Utf8 and LargeUtf8 are 5 and 20 in the union.
+            auto field = flat.table({4, 1, 1, 4, 0, 4});
+            flat.link(fields + 4 + 4 * i, field[0]);
+            flat.set<std::uint8_t>(field[2], 1);
+            flat.set<std::uint8_t>(field[3], columns[i].large() ? 20 : 5);
+            flat.link(field[1], flat.string(columns[i].name));
+            flat.link(field[4], flat.table({})[0]);
+            flat.link(field[6], flat.vector(0, 4));
+        }
+        return schema[0];
+    }
+
+
+    template <typename Header> static std::string message(std::uint8_t type, std::int64_t body_size, Header header) {
+        // Returns the encapsulated message: the continuation marker, the size of the Message flatbuffer, and the flatbuffer padded
+        // to 8 bytes. header writes the table of the header, Schema (1) or RecordBatch (3), and returns its position.
+        FlatBuffer flat;
+        auto table = flat.table({2, 1, 4, 8});
+        flat.link(0, table[0]);
+        flat.set<std::int16_t>(table[1], metadata_version);
+        flat.set<std::uint8_t>(table[2], type);
+        flat.set<std::int64_t>(table[4], body_size);
+        flat.link(table[3], header(flat));
+        flat.pad(8);
+
+        std::uint32_t size = flat.bytes.size();
+        return std::string(4, '\xFF') + std::string(reinterpret_cast<const char*>(&size), 4) + flat.bytes;
+    }
+
+
+    // Private data of the exported structures.
+
+    struct SchemaData {
+        std::string format, name;
+        std::vector<ArrowSchema> children_storage;
+        std::vector<ArrowSchema*> children;
+    };
+
+    struct ArrayData {
+        Column column;
+        std::vector<const void*> buffers;
+        std::vector<ArrowArray> children_storage;
+        std::vector<ArrowArray*> children;
+    };
+
+
+    static void fill_schema(ArrowSchema& schema, SchemaData* data) {
+        // Points the schema to its private data.
+        schema.format = data->format.c_str();
+        schema.name = data->name.c_str();
+        schema.metadata = nullptr;
+        schema.flags = 0;
+        schema.n_children = data->children.size();
+        schema.children = data->children.data();
+        schema.dictionary = nullptr;
+        schema.release = &release_schema;
+        schema.private_data = data;
+    }
+
+    static void fill_array(ArrowArray& array, ArrayData* data, size_type length, std::int64_t null_count) {
+        // Points the array to its private data.
+        array.length = length;
+        array.null_count = null_count;
+        array.offset = 0;
+        array.n_buffers = data->buffers.size();
+        array.n_children = data->children.size();
+        array.buffers = data->buffers.data();
+        array.children = data->children.data();
+        array.dictionary = nullptr;
+        array.release = &release_array;
+        array.private_data = data;
+    }
+
+
+    static void release_schema(ArrowSchema* schema) {
+        // Releases children which weren't moved by the consumer and frees the private data.
+        auto* data = static_cast<SchemaData*>(schema->private_data);
+        for (auto* i : data->children)
+            if (i->release)
+                i->release(i);
+        delete data;
+        schema->release = nullptr;
+    }
+
+    static void release_array(ArrowArray* array) {
+        auto* data = static_cast<ArrayData*>(array->private_data);
+        for (auto* i : data->children)
+            if (i->release)
+                i->release(i);
+        delete data;
+        array->release = nullptr;
+    }
+
+    static void release(ArrowArray* array, ArrowSchema* schema) {
+        if (array->release)
+            array->release(array);
+        if (schema->release)
+            schema->release(schema);
+    }
+
+
+    template <typename Offset> static void read_column(vector_v_s& values, ArrowArray* child, std::int64_t offset) {
+        // Appends fields of one utf8 child array to the rows.
+        auto* validity = static_cast<const std::uint8_t*>(child->buffers[0]);
+        auto* offsets = static_cast<const Offset*>(child->buffers[1]);
+        auto* bytes = static_cast<const char*>(child->buffers[2]);
+
+        for (size_type r = 0; r < values.size(); ++r) {
+            std::int64_t i = offset + child->offset + r;
+            if (validity && child->null_count != 0 && !(validity[i / 8] & (1 << (i % 8))))
+                values[r].emplace_back();
+            else
+                values[r].emplace_back(bytes + offsets[i], offsets[i + 1] - offsets[i]);
+        }
+    }
+
+
+    static void read_table(CSVData& data, ArrowArray* array, ArrowSchema* schema) {
+        // Checks types of the structures and copies their fields into data.
+        if (std::strcmp(schema->format, "+s") != 0 || array->n_children != schema->n_children)
+            throw std::invalid_argument("Only struct arrays can be imported as a table.");
+
+        for (std::int64_t i = 0; i < schema->n_children; ++i) {
+            auto* child_schema = schema->children[i];
+            // The name is optional in the C data interface.
+            std::string name = child_schema->name ? child_schema->name : "";
+            if ((std::strcmp(child_schema->format, "u") != 0 && std::strcmp(child_schema->format, "U") != 0) ||
+                array->children[i]->n_buffers != 3)
+                throw std::invalid_argument("The column \"" + name + "\" isn't a utf8 array.");
+            if (array->children[i]->length < array->offset + array->length)
+                throw std::invalid_argument("The column \"" + name + "\" is too short.");
+        }
+
+        // Columns are added to a new table first, so repeated names raise before data is changed.
+        CSVData table;
+        for (std::int64_t i = 0; i < schema->n_children; ++i)
+            table.add_column(schema->children[i]->name ? schema->children[i]->name : "");
+
+        auto& values = table.get_values();
+        values.resize(array->length);
+        for (auto& row : values)
+            row.reserve(schema->n_children);
+
+        for (std::int64_t i = 0; i < schema->n_children; ++i) {
+            if (schema->children[i]->format[0] == 'u')
+                read_column<std::int32_t>(values, array->children[i], array->offset);
+            else
+                read_column<std::int64_t>(values, array->children[i], array->offset);
+        }
+
+        data.clear();
+        data.get_column_index().swap(table.get_column_index());
+        data.get_values().swap(values);
+    }
+};
+
+
+}
+
+
+#endif
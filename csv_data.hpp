@@ -9,6 +9,11 @@
 #include <map>
 #include <stdexcept>
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 
 #include "./csv_encoder.hpp"
 
@@ -106,6 +111,44 @@ public:
     };
 
 
+    struct ColumnMemory {
+    // Memory used by fields of one column. All sizes are in bytes.
+        std::string name;
+        // Sizes of field values.
+        index_type payload_bytes = 0;
+        // Size of std::string objects inside rows.
+        index_type object_bytes = 0;
+        // Size of heap blocks of fields which don't fit into the small string buffer.
+        index_type heap_bytes = 0;
+        // Numbers of fields stored on the heap and inside std::string objects.
+        index_type heap_fields = 0;
+        index_type sso_fields = 0;
+    };
+
+
+    struct MemoryUsage {
+    // Memory used by the CSVData. All sizes are in bytes.
+        std::vector<ColumnMemory> columns;
+        // Size of the CSVData object.
+        index_type object_bytes = 0;
+        // Size of the rows vector, including its spare capacity.
+        index_type row_bytes = 0;
+        // Spare capacity of the rows vector and of all rows.
+        index_type spare_row_bytes = 0;
+        index_type spare_field_bytes = 0;
+        // Estimated size of the column index.
+        index_type index_bytes = 0;
+
+        index_type total() const {
+            // Returns the size of everything together.
+            index_type output = object_bytes + row_bytes + spare_field_bytes + index_bytes;
+            for (auto& i : columns)
+                output += i.object_bytes + i.heap_bytes;
+            return output;
+        }
+    };
+
+
     // CSVData class attributes and methods.
 
 
@@ -199,26 +242,24 @@ public:
     }
 
 
-    CSVEncoder<vector_v_s::iterator> encode_content(std::string delimiter, char quote) {
-        // Creates CSVEncoder which encodes all the content of this CSVData.
-        return CSVEncoder<vector_v_s::iterator>(values.begin(), values.end(), delimiter, quote);
+    template <typename Quoting = QuoteMinimal> CSVEncoder<vector_v_s::iterator, Quoting> encode_content(std::string delimiter, char quote) {
+        // Creates CSVEncoder which encodes all the content of this CSVData with the quoting policy.
+        return CSVEncoder<vector_v_s::iterator, Quoting>(values.begin(), values.end(), delimiter, quote);
     }
 
-    CSVEncoder<vector_v_s::iterator> encode_content() {
-        return encode_content(delimiter, quote);
+    template <typename Quoting = QuoteMinimal> CSVEncoder<vector_v_s::iterator, Quoting> encode_content() {
+        return encode_content<Quoting>(delimiter, quote);
     }
 
 
     operator std::string() {
         // Creates string representation of the data.
-        std::string output;
+        StringSink output;
 
-        output += get_header_line() + "\n";
+        output.buffer += get_header_line() + "\n";
+        encode_content().encode_all(output);
 
-        for (auto i : encode_content())
-            output += i + "\n";
-
-        return output;
+        return std::move(output.buffer);
     }
 
 
@@ -235,6 +276,7 @@ public:
         is_row_index_valid(index);
 
         values.erase(values.begin() + index);
+        synced_rows = std::min(synced_rows, index);
 
         return *this;
     }
@@ -250,6 +292,7 @@ public:
 
         auto start = values.begin() + from;
         values.erase(start, start + number);
+        synced_rows = std::min(synced_rows, from);
 
         return *this;
     }
@@ -275,6 +318,14 @@ public:
         return *this;
     }
 
+    CSVData& add_row_unchecked(vector_s&& row) {
+        // Moves "row" to the end of the values vector without checking its size, which must be the number of columns.
+        // Used by readers, which already give rows of the right size.
+        values.push_back(std::move(row));
+
+        return *this;
+    }
+
     CSVData& add_row(const vector_s& row, index_type number) {
         // Adds "number" rows with value "row" at the end of the values vector.
         is_row_valid(row);
@@ -302,6 +353,7 @@ public:
         is_row_index_valid(to);
 
         values.insert(values.begin() + to, number, vector_s(column_index.size(), ""));
+        synced_rows = std::min(synced_rows, to);
 
         return *this;
     }
@@ -313,6 +365,7 @@ public:
         is_row_valid(row);
 
         values.insert(values.begin() + to, number, row);
+        synced_rows = std::min(synced_rows, to);
 
         return *this;
     }
@@ -324,6 +377,7 @@ public:
         is_sequence_of_rows_valid(rows);
 
         values.insert(values.begin() + to, rows);
+        synced_rows = std::min(synced_rows, to);
 
         return *this;
     }
@@ -336,6 +390,7 @@ public:
         is_column_already_exist(name);
 
         _add_column(name, value);
+        synced_rows = 0;
 
         return *this;
     }
@@ -351,28 +406,247 @@ public:
 
         for (auto &i : values)
             i.erase(i.begin() + index);
+        synced_rows = 0;
+
+        return *this;
+    }
+
+
+    CSVData& distinct(bool keep_first = true, bool preserve_order = true, unsigned threads = 0) {
+        // Deletes duplicate rows. See .distinct_by().
+        return distinct_by(get_column_names(), keep_first, preserve_order, threads);
+    }
+
+
+    CSVData& distinct_by(const vector_s& columns, bool keep_first = true, bool preserve_order = true, unsigned threads = 0) {
+        /* Deletes rows which have the same values in given columns as another row. Raises std::invalid_argument if there is no such column.
+         * Arguments:
+         *     columns: Names of columns which are compared.
+         *     keep_first: If true, the first of duplicate rows is kept, else the last one.
+         *     preserve_order: If false, deleted rows may be replaced by rows from the end, which moves fewer rows.
+         *     threads: Number of threads. If 0, the number of hardware threads is used.
+         *
+         * Every row is hashed once. Rows are partitioned between threads by hash, and compared field by field only if hashes are equal.
+         */
+        std::vector<index_type> keys;
+        for (auto& i : columns) {
+            is_column_not_exist(i);
+            keys.push_back(column_index[i]);
+        }
+
+        const index_type size = values.size();
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = static_cast<unsigned>(std::min<index_type>(threads, size / 4096 + 1));
+
+        // Hashes of rows.
+        std::vector<std::uint64_t> hashes(size);
+        run_in_threads(threads, [&](unsigned thread) {
+            for (index_type i = size * thread / threads, end = size * (thread + 1) / threads; i < end; ++i)
+                hashes[i] = hash_row(values[i], keys);
+        });
+
+        // Every thread looks for duplicates among rows whose hash belongs to its partition.
+        std::vector<char> keep(size, 0);
+        std::vector<index_type> next_same_hash(size);
+        run_in_threads(threads, [&](unsigned thread) {
+            std::unordered_map<std::uint64_t, index_type> first_same_hash;
+            first_same_hash.reserve(size / threads);
+
+            for (index_type n = 0; n < size; ++n) {
+                index_type i = keep_first ? n : size - 1 - n;
+                if (hashes[i] % threads != thread)
+                    continue;
+
+                auto [found, inserted] = first_same_hash.try_emplace(hashes[i], i);
+                if (!inserted) {
+                    auto j = found->second;
+                    while (j != size && !are_rows_equal(values[i], values[j], keys))
+                        j = next_same_hash[j];
+                    if (j != size)
+                        continue;
+                    next_same_hash[i] = found->second;
+                    found->second = i;
+                }
+                else
+                    next_same_hash[i] = size;
+
+                keep[i] = 1;
+            }
+        });
+
+        // Rows from the first deleted one change their places.
+        index_type first_deleted = 0;
+        while (first_deleted < size && keep[first_deleted])
+            ++first_deleted;
+        synced_rows = std::min(synced_rows, first_deleted);
+
+        // Moves kept rows into place of deleted ones.
+        index_type kept = 0;
+        if (preserve_order) {
+            for (index_type i = 0; i < size; ++i)
+                if (keep[i]) {
+                    if (kept != i)
+                        values[kept] = std::move(values[i]);
+                    ++kept;
+                }
+        }
+        else {
+            index_type end = size;
+            while (kept < end) {
+                if (keep[kept])
+                    ++kept;
+                else if (keep[--end])
+                    values[kept++] = std::move(values[end]);
+            }
+        }
+        values.erase(values.begin() + kept, values.end());
 
         return *this;
     }
 
 
+    MemoryUsage memory_usage(index_type sample_rows = 0) const {
+        // Reports memory used by the data, without allocating anything but the report and the order of columns.
+        // If sample_rows is 0, goes through all fields, which costs O(rows * columns). Otherwise measures only that many evenly spaced
+        // rows and scales their numbers to all rows, so the cost doesn't depend on the number of rows, and the report is an estimate.
+        // Counters can't be kept up to date instead, because fields are changed through references.
+        MemoryUsage output;
+        output.object_bytes = sizeof(CSVData);
+        output.row_bytes = values.capacity() * sizeof(vector_s);
+        output.spare_row_bytes = (values.capacity() - values.size()) * sizeof(vector_s);
+
+        // Nodes of std::map contain the value, three pointers and the color.
+        // Indexes may have gaps after .delete_column(), so columns are placed by the order of their indexes, like fields in rows.
+        std::vector<const map_s_i::value_type*> order;
+        order.reserve(column_index.size());
+        for (auto& i : column_index) {
+            output.index_bytes += sizeof(map_s_i::value_type) + 4 * sizeof(void*) + heap_size(i.first);
+            order.push_back(&i);
+        }
+        std::sort(order.begin(), order.end(), [](auto left, auto right) {return left->second < right->second;});
+
+        output.columns.resize(order.size());
+        for (index_type i = 0; i < order.size(); ++i)
+            output.columns[i].name = order[i]->first;
+
+        index_type rows = values.size();
+        index_type measured = sample_rows && sample_rows < rows ? sample_rows : rows;
+        for (index_type r = 0; r < measured; ++r) {
+            auto& row = values[measured == rows ? r : r * rows / measured];
+            output.spare_field_bytes += (row.capacity() - row.size()) * sizeof(std::string);
+
+            for (index_type c = 0; c < row.size() && c < output.columns.size(); ++c) {
+                auto& column = output.columns[c];
+                auto heap = heap_size(row[c]);
+
+                column.payload_bytes += row[c].size();
+                column.object_bytes += sizeof(std::string);
+                column.heap_bytes += heap;
+                ++(heap ? column.heap_fields : column.sso_fields);
+            }
+        }
+
+        if (measured != rows) {
+            auto scale = [rows, measured](index_type& number) {
+                number = static_cast<index_type>(static_cast<double>(number) * rows / measured + 0.5);
+            };
+            scale(output.spare_field_bytes);
+            for (auto& column : output.columns) {
+                scale(column.payload_bytes);
+                scale(column.object_bytes);
+                scale(column.heap_bytes);
+                scale(column.heap_fields);
+                scale(column.sso_fields);
+            }
+        }
+
+        return output;
+    }
+
+
+    CSVData& shrink_to_fit() {
+        // Releases spare capacity of the rows vector, of every row, and of every field.
+        values.shrink_to_fit();
+        for (auto& row : values) {
+            row.shrink_to_fit();
+            for (auto& i : row)
+                i.shrink_to_fit();
+        }
+        return *this;
+    }
+
+
+    CSVData& reserve(index_type rows) {
+        // Reserves storage for "rows" rows, so adding rows up to this number doesn't move the existing ones.
+        values.reserve(rows);
+        return *this;
+    }
+
+
     CSVData& clear() {
         // Deletes all rows and columns. It may invalidate references, pointers, and iterators referring to deleted elements.
 
         values.clear();
         column_index.clear();
+        synced_rows = 0;
 
         return *this;
     }
 
 
+    // Change tracking. Rows before the first dirty row are known to be the same as the first rows of the file
+    // which the data was last read from or written to. Methods which insert, delete or move rows lower the first dirty row,
+    // and rows added at the end are after it anyway. Fields changed through references, iterators or columns
+    // must be marked with .mark_dirty(). CSVWriter in the append mode uses this to write only changed and new rows.
+
+
+    index_type first_dirty_row() {
+        return synced_rows;
+    }
+
+    index_type file_row_number() {
+        // Returns the number of rows which the file had at the last synchronization.
+        return file_rows;
+    }
+
+    bool is_dirty() {
+        // Checks if the data differs from the file.
+        return synced_rows != values.size() || synced_rows != file_rows;
+    }
+
+    CSVData& mark_dirty(index_type index) {
+        // Marks the row as changed. Raises std::invalid_argument if the row index is out of bounds.
+        is_row_index_valid(index);
+        synced_rows = std::min(synced_rows, index);
+        return *this;
+    }
+
+    CSVData& mark_synced() {
+        // Marks all rows as the same as the file. Called after the data is read from or written to the file.
+        synced_rows = file_rows = values.size();
+        return *this;
+    }
+
+
 
 private:
 
+    struct StringSink {
+    // Appends encoded rows to the string. Sinks of "csv_sink.hpp" aren't used here, so CSVData doesn't depend on POSIX headers.
+        std::string buffer;
+
+        void write(const char* data, index_type size) {
+            buffer.append(data, size);
+        }
+    };
+
     // Table with column names and thier indexes in vector.
     map_s_i column_index;
     // Vector with all data.
     vector_v_s values;
+    // Number of leading rows which are the same as in the file, and the number of rows in the file.
+    index_type synced_rows = 0, file_rows = 0;
 
 
     void _add_column(std::string name, std::string value = "") {
@@ -382,6 +656,61 @@ private:
             i.push_back(value);
     }
 
+    template <typename F> static void run_in_threads(unsigned threads, F function) {
+        // Calls function(thread) for every thread index, using the current thread as the last one.
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i + 1 < threads; ++i)
+            workers.emplace_back(function, i);
+        function(threads - 1);
+        for (auto& i : workers)
+            i.join();
+    }
+
+    static std::uint64_t hash_row(const vector_s& row, const std::vector<index_type>& keys) {
+        // Hashes given fields of a row. Reads 8 bytes at once and mixes them by multiplication, with the field size as a separator.
+        const std::uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+        std::uint64_t hash = 0;
+
+        auto mix = [&hash, multiplier](std::uint64_t word) {
+            hash = (hash ^ word) * multiplier;
+            hash ^= hash >> 29;
+        };
+
+        for (auto k : keys) {
+            auto& field = row[k];
+            const char* data = field.data();
+            auto rest = field.size();
+
+            for (; rest >= 8; data += 8, rest -= 8) {
+                std::uint64_t word;
+                std::memcpy(&word, data, 8);
+                mix(word);
+            }
+            std::uint64_t word = 0;
+            std::memcpy(&word, data, rest);
+            mix(word);
+            mix(field.size());
+        }
+
+        return hash ^ (hash >> 32);
+    }
+
+    static bool are_rows_equal(const vector_s& left, const vector_s& right, const std::vector<index_type>& keys) {
+        // Compares given fields of two rows.
+        for (auto k : keys)
+            if (left[k] != right[k])
+                return false;
+        return true;
+    }
+
+    static index_type heap_size(const std::string& field) {
+        // Returns the size of the heap block of a string, or 0 if it's stored inside the string object.
+        auto object = reinterpret_cast<const char*>(&field);
+        if (field.data() >= object && field.data() < object + sizeof(std::string))
+            return 0;
+        return field.capacity() + 1;
+    }
+
     // Methods for data validation.
 
      void is_row_valid(const vector_s& row) {
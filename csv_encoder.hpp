@@ -6,17 +6,38 @@
 
 #include <vector>
 #include <string>
+#include <cstring>
+#include <type_traits>
 #include <stdexcept>
 
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 
 namespace csvm {
 
 
-template <typename IterIterStr> class CSVEncoder {
+// Quoting policies of CSVEncoder.
+
+// Encloses in quotes only fields which contain the delimiter, the quote, CR or LF.
+struct QuoteMinimal {};
+// Encloses every field in quotes. Fields are only searched for quotes, which are doubled.
+struct QuoteAll {};
+// Encloses every field which isn't a decimal number in quotes, and numbers which need quotes with QuoteMinimal,
+// like "1.5" with the delimiter ".".
+struct QuoteNonNumeric {};
+// Never encloses and never escapes anything. Fields are copied as is, so they must not contain special characters.
+struct QuoteNever {};
+
+
+template <typename IterIterStr, typename Quoting = QuoteMinimal> class CSVEncoder {
 /* Encodes strings from the iterable of iterables into the CSV format strings.
  * On construction, takes begin and end streams, delimiter string and quote character.
+ * Quoting is one of the quoting policies above, and every policy gets its own field classification.
  *
  * begin() creates and returns an Iterator from the start, end() returns an Iterator from the end.
+ * encode_all() writes everything into a sink.
  *
  * Encoder class encodes things, Iterator class iterates encoder.
  *
@@ -62,44 +83,201 @@ public:
 
         Encoder& encode() {
             // Encodes one iterable from the iterator and puts result into the string attribute.
-            string = "";
-
-            auto iterable = *source_iter;
-            auto begin = iterable.begin(), end = iterable.end();
+            // The string keeps its capacity, so after the first rows it's encoded without allocations.
+            string.clear();
+            append_to(string);
+            return *this;
+        }
 
-            // Encodes first iterable.
-            if (begin != end)
-                string += encode_field(*begin++);
+        std::string& append_to(std::string& output) {
+            // Encodes one iterable from the iterator and appends result to the output.
+            // The encoded size is computed first, so the output is reallocated at most once, and every byte is written once.
+            auto&& iterable = *source_iter;
+            output.reserve(output.size() + measure(iterable));
+            write(iterable, [&output](const char* data, size_type size) {output.append(data, size);});
+            return output;
+        }
 
-            // Encodes the rest.
-            while (begin != end)
-                string = string + delimiter + encode_field(*begin++);
+        size_type size() {
+            // Returns the encoded size of one iterable from the iterator without encoding it.
+            return measure(*source_iter);
+        }
 
-            return *this;
+        template <typename Sink> Sink& encode_to(Sink& sink) {
+            // Encodes one iterable from the iterator and writes result into the sink, piece by piece.
+            auto&& iterable = *source_iter;
+            measure(iterable);
+            write(iterable, [&sink](const char* data, size_type size) {sink.write(data, size);});
+            return sink;
         }
 
     private:
-        // Characters which should provoke the field enclosed.
-        std::string enclose_pattern = static_cast<std::string>("\r\n") + quote;
+        // How one field is encoded: is it enclosed in quotes, and how many quotes it has.
+        struct FieldInfo {
+            bool enclose;
+            size_type quotes;
+        };
+
+        // Information about fields of the current iterable.
+        std::vector<FieldInfo> fields;
+
+
+        FieldInfo classify(const std::string& field) const {
+            // Finds out how the field is encoded with the quoting policy.
+            if constexpr (std::is_same_v<Quoting, QuoteNever>)
+                return FieldInfo{false, 0};
+            else if constexpr (std::is_same_v<Quoting, QuoteAll>)
+                return FieldInfo{true, count_quotes(field)};
+            else if constexpr (std::is_same_v<Quoting, QuoteNonNumeric>)
+                return is_numeric(field) ? classify_minimal(field) : FieldInfo{true, count_quotes(field)};
+            else
+                return classify_minimal(field);
+        }
+
+
+        size_type count_quotes(const std::string& field) const {
+            // Counts quotes, jumping between them with memchr.
+            size_type output = 0;
+            const char* begin = field.data();
+            const char* end = begin + field.size();
+            while ((begin = static_cast<const char*>(std::memchr(begin, quote, end - begin)))) {
+                ++output;
+                ++begin;
+            }
+            return output;
+        }
+
 
+        static bool is_numeric(const std::string& field) {
+            // Checks if the field is a decimal number: an optional sign, digits with an optional point, and an optional exponent.
+            const char* i = field.data();
+            const char* end = i + field.size();
+            auto is_digit = [](char c) {return c >= '0' && c <= '9';};
 
-        std::string encode_field(const std::string &field) {
-            // Encodes one field. Encloses in quotes if necessary.
+            if (i != end && (*i == '+' || *i == '-'))
+                ++i;
 
-            std::string output = field;
+            const char* digits = i;
+            while (i != end && is_digit(*i))
+                ++i;
+            bool has_digits = i != digits;
 
-            // Doubles all quotes inside.
-            std::string::size_type position = field.find(quote);
-            while (position != std::string::npos) {
-                output.insert(position, 1, quote);
-                position = field.find(quote, position + 1);
+            if (i != end && *i == '.') {
+                digits = ++i;
+                while (i != end && is_digit(*i))
+                    ++i;
+                has_digits |= i != digits;
             }
+            if (!has_digits)
+                return false;
+
+            if (i != end && (*i == 'e' || *i == 'E')) {
+                if (++i != end && (*i == '+' || *i == '-'))
+                    ++i;
+                digits = i;
+                while (i != end && is_digit(*i))
+                    ++i;
+                if (i == digits)
+                    return false;
+            }
+
+            return i == end;
+        }
 
-            // Adds the quote enclose if necessary.
-            if (field.find(delimiter) != std::string::npos || field.find_first_of(enclose_pattern) != std::string::npos)
-                output = quote + output + quote;
 
-            return output;
+        FieldInfo classify_minimal(const std::string& field) const {
+            // Finds out in one pass if the field should be enclosed in quotes, and counts quotes in it.
+            // Checks 32 or 16 bytes at once for the quote, CR, LF and the first delimiter character, if AVX2 or SSE2 is available.
+            FieldInfo info{false, 0};
+            bool delimiter_start = false;
+
+            const char* data = field.data();
+            size_type size = field.size(), i = 0;
+
+#if defined(__AVX2__)
+            const __m256i quotes_32 = _mm256_set1_epi8(quote), cr_32 = _mm256_set1_epi8('\r'), lf_32 = _mm256_set1_epi8('\n'),
+                          delimiters_32 = _mm256_set1_epi8(delimiter[0]);
+
+            for (; i + 32 <= size; i += 32) {
+                __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+                info.quotes += __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, quotes_32)));
+                info.enclose |= _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(block, cr_32), _mm256_cmpeq_epi8(block, lf_32))) != 0;
+                delimiter_start |= _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, delimiters_32)) != 0;
+            }
+#endif
+
+#if defined(__SSE2__)
+            const __m128i quotes_16 = _mm_set1_epi8(quote), cr_16 = _mm_set1_epi8('\r'), lf_16 = _mm_set1_epi8('\n'),
+                          delimiters_16 = _mm_set1_epi8(delimiter[0]);
+
+            for (; i + 16 <= size; i += 16) {
+                __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+                info.quotes += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(block, quotes_16)));
+                info.enclose |= _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, cr_16), _mm_cmpeq_epi8(block, lf_16))) != 0;
+                delimiter_start |= _mm_movemask_epi8(_mm_cmpeq_epi8(block, delimiters_16)) != 0;
+            }
+#endif
+
+            for (; i < size; ++i) {
+                char c = data[i];
+                info.quotes += c == quote;
+                info.enclose |= c == '\n' || c == '\r';
+                delimiter_start |= c == delimiter[0];
+            }
+
+            if (info.quotes)
+                info.enclose = true;
+            else if (!info.enclose && delimiter_start)
+                info.enclose = delimiter.size() == 1 || field.find(delimiter) != std::string::npos;
+
+            return info;
+        }
+
+
+        template <typename Iterable> size_type measure(const Iterable& iterable) {
+            // Classifies all fields of the iterable and returns its encoded size.
+            fields.clear();
+            size_type size = 0;
+
+            for (auto& field : iterable) {
+                auto info = classify(field);
+                fields.push_back(info);
+                size += field.size() + info.quotes + (info.enclose ? 2 : 0);
+            }
+
+            if (!fields.empty())
+                size += delimiter.size() * (fields.size() - 1);
+
+            return size;
+        }
+
+
+        template <typename Iterable, typename Put> void write(const Iterable& iterable, Put put) const {
+            // Passes pieces of the encoded iterable to put(data, size). The iterable must be measured first.
+            size_type index = 0;
+
+            for (auto& field : iterable) {
+                if (index)
+                    put(delimiter.data(), delimiter.size());
+
+                auto info = fields[index++];
+                if (info.enclose)
+                    put(&quote, 1);
+
+                // Doubles all quotes inside by writing every quote twice.
+                const char* begin = field.data();
+                const char* end = begin + field.size();
+                for (size_type i = 0; i < info.quotes; ++i) {
+                    auto position = static_cast<const char*>(std::memchr(begin, quote, end - begin)) + 1;
+                    put(begin, position - begin);
+                    put(&quote, 1);
+                    begin = position;
+                }
+                put(begin, end - begin);
+
+                if (info.enclose)
+                    put(&quote, 1);
+            }
         }
 
     };
@@ -185,6 +363,34 @@ public:
     }
 
 
+    template <typename Sink> Sink& encode_all(Sink& sink, const std::string& line_end = "\n") {
+        // Encodes all iterables from the begin to the end into the sink, each followed by line_end.
+        // Unlike the iteration, it doesn't create a string for every row. Sinks are in "csv_sink.hpp".
+        for (encoder.reset(source_begin); encoder.source_iter != source_end; encoder.next()) {
+            encoder.encode_to(sink);
+            sink.write(line_end.data(), line_end.size());
+        }
+        return sink;
+    }
+
+
+    size_type encoded_size(const std::string& line_end = "\n") {
+        // Returns the number of bytes which encode_all() writes, without encoding anything.
+        size_type output = 0;
+        for (encoder.reset(source_begin); encoder.source_iter != source_end; encoder.next())
+            output += encoder.size() + line_end.size();
+        return output;
+    }
+
+    std::vector<size_type> encoded_sizes(const std::string& line_end = "\n") {
+        // Returns sizes of all encoded iterables with line ends, as encode_all() writes them, without encoding anything.
+        std::vector<size_type> output;
+        for (encoder.reset(source_begin); encoder.source_iter != source_end; encoder.next())
+            output.push_back(encoder.size() + line_end.size());
+        return output;
+    }
+
+
 private:
     // Begin and end iterators for the encoder.
     IterIterStr source_begin;
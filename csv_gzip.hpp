@@ -0,0 +1,481 @@
+// Header with gzip input and output: CSVGzipInput, CSVGzipSink and CSVGzipWriter. Requires zlib, so link with -lz.
+
+#ifndef CSV_MANAGER_CSV_GZIP
+#define CSV_MANAGER_CSV_GZIP
+
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <streambuf>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+#include "./csv_data.hpp"
+#include "./csv_encoder.hpp"
+#include "./csv_sink.hpp"
+
+
+namespace csvm {
+
+
+class CSVGzipInput : public std::streambuf {
+/* Stream buffer which decompresses a gzip or zlib file on a background thread, so decompression overlaps with parsing.
+ * Decompressed chunks are passed to the reading thread through a queue of at most queue_size chunks.
+ * Concatenated gzip members are read one after another, and zero padding after them is ignored, as gzip does.
+ *
+ * Give it to CSVReader to read a compressed file: CSVReader(data, CSVGzipInput::open(path)).
+ * If the data is broken or the file is truncated, reading raises an exception, which sets the bad bit of the stream.
+ * Other bytes after the last member are reported the same way, but only after all the decompressed data is read.
+ */
+public:
+
+    using size_type = std::string::size_type;
+
+
+    CSVGzipInput(std::string path, size_type chunk_size = 1 << 20, size_type queue_size = 4) :
+                chunk_size{std::max<size_type>(chunk_size, 1)}, queue_size{std::max<size_type>(queue_size, 1)} {
+        // Opens the file and starts decompression. Raises std::runtime_error if the file can't be opened.
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Can't open the file \"" + path + "\".");
+        worker = std::thread(&CSVGzipInput::work, this);
+    }
+
+    CSVGzipInput(const CSVGzipInput&) = delete;
+    CSVGzipInput& operator=(const CSVGzipInput&) = delete;
+
+    ~CSVGzipInput() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopped = true;
+        }
+        space_ready.notify_one();
+        worker.join();
+        ::close(fd);
+    }
+
+
+    static std::unique_ptr<std::streambuf> open(const std::string& path) {
+        // Opens the file with CSVGzipInput if it starts with the gzip magic number, or as a plain file otherwise.
+        // Raises std::runtime_error if the file can't be opened.
+        unsigned char magic[2] = {0, 0};
+        std::ifstream(path, std::ios::binary).read(reinterpret_cast<char*>(magic), 2);
+        if (magic[0] == 0x1f && magic[1] == 0x8b)
+            return std::make_unique<CSVGzipInput>(path);
+
+        auto output = std::make_unique<std::filebuf>();
+        if (!output->open(path, std::ios::in | std::ios::binary))
+            throw std::runtime_error("Can't open the file \"" + path + "\".");
+        return output;
+    }
+
+
+protected:
+
+    int_type underflow() override {
+        // Replaces the current chunk with the next decompressed one, waiting for the background thread.
+        if (gptr() < egptr())
+            return traits_type::to_int_type(*gptr());
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!current.empty()) {
+            current.clear();
+            free.push_back(std::move(current));
+            space_ready.notify_one();
+        }
+        data_ready.wait(lock, [this]() {return !ready.empty() || finished;});
+        if (ready.empty()) {
+            if (error)
+                std::rethrow_exception(error);
+            return traits_type::eof();
+        }
+
+        current = std::move(ready.front());
+        ready.pop_front();
+        lock.unlock();
+        space_ready.notify_one();
+
+        setg(current.data(), current.data(), current.data() + current.size());
+        return traits_type::to_int_type(*gptr());
+    }
+
+
+private:
+    int fd;
+    size_type chunk_size, queue_size;
+
+    // Decompressed chunks, spare chunks, and the chunk which is being read.
+    std::deque<std::string> ready, free;
+    std::string current;
+
+    // The background thread and its synchronization.
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable data_ready, space_ready;
+    bool finished = false, stopped = false;
+    std::exception_ptr error;
+
+
+    std::string take_chunk() {
+        // Returns a spare chunk, or a new one.
+        std::lock_guard<std::mutex> lock(mutex);
+        if (free.empty())
+            return std::string();
+        auto output = std::move(free.back());
+        free.pop_back();
+        return output;
+    }
+
+    bool pass_chunk(std::string& chunk) {
+        // Passes the chunk to the reading thread, waiting while the queue is full. Returns false if the buffer is destroyed.
+        std::unique_lock<std::mutex> lock(mutex);
+        space_ready.wait(lock, [this]() {return ready.size() < queue_size || stopped;});
+        if (stopped)
+            return false;
+        ready.push_back(std::move(chunk));
+        lock.unlock();
+        data_ready.notify_one();
+        return true;
+    }
+
+
+    void work() {
+        // Reads the file by pieces and inflates them into chunks until the end of the file.
+        z_stream stream{};
+        bool initialized = false;
+
+        try {
+            // 15 + 32 makes zlib detect both gzip and zlib headers.
+            if (inflateInit2(&stream, 15 + 32) != Z_OK)
+                throw std::runtime_error("Can't start decompression.");
+            initialized = true;
+
+            std::vector<unsigned char> input(std::min<size_type>(chunk_size, 1 << 18));
+            auto chunk = take_chunk();
+            chunk.resize(chunk_size);
+            size_type used = 0, members = 0, trailing = 0;
+            bool in_member = false;
+
+            while (!trailing) {
+                auto got = ::read(fd, input.data(), input.size());
+                if (got < 0) {
+                    if (errno == EINTR)
+                        continue;
+                    throw std::runtime_error("Can't read the compressed file: " + std::string(std::strerror(errno)) + ".");
+                }
+                if (got == 0)
+                    break;
+
+                stream.next_in = input.data();
+                stream.avail_in = got;
+
+                while (stream.avail_in) {
+                    if (!in_member) {
+                        // A new gzip member starts after the end of the previous one. Zero bytes between and after members
+                        // are padding, and other bytes which don't start a gzip member are trailing garbage.
+                        if (members) {
+                            while (stream.avail_in && !*stream.next_in) {
+                                ++stream.next_in;
+                                --stream.avail_in;
+                            }
+                            if (!stream.avail_in)
+                                break;
+                            if (*stream.next_in != 0x1f) {
+                                trailing = stream.avail_in;
+                                break;
+                            }
+                        }
+                        inflateReset(&stream);
+                        in_member = true;
+                    }
+
+                    stream.next_out = reinterpret_cast<Bytef*>(chunk.data() + used);
+                    stream.avail_out = chunk_size - used;
+                    auto result = inflate(&stream, Z_NO_FLUSH);
+                    used = chunk_size - stream.avail_out;
+
+                    if (result == Z_STREAM_END) {
+                        in_member = false;
+                        ++members;
+                    }
+                    else if (result != Z_OK && result != Z_BUF_ERROR)
+                        throw std::runtime_error("The compressed file is broken: " + std::string(stream.msg ? stream.msg : "unknown error") + ".");
+
+                    if (used == chunk_size) {
+                        if (!pass_chunk(chunk)) {
+                            inflateEnd(&stream);
+                            return;
+                        }
+                        chunk = take_chunk();
+                        chunk.resize(chunk_size);
+                        used = 0;
+                    }
+                }
+            }
+
+            if (in_member)
+                throw std::runtime_error("The compressed file is truncated.");
+
+            if (used) {
+                chunk.resize(used);
+                if (!pass_chunk(chunk)) {
+                    inflateEnd(&stream);
+                    return;
+                }
+            }
+
+            if (trailing) {
+                // The rest of the file is counted too, if the file can be seeked.
+                auto position = ::lseek(fd, 0, SEEK_CUR), end = ::lseek(fd, 0, SEEK_END);
+                if (position >= 0 && end >= position)
+                    trailing += end - position;
+                throw std::runtime_error("The compressed file has " + std::to_string(trailing) + " trailing bytes which aren't gzip data.");
+            }
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            error = std::current_exception();
+        }
+
+        if (initialized)
+            inflateEnd(&stream);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished = true;
+        }
+        data_ready.notify_one();
+    }
+};
+
+
+class CSVGzipSink {
+/* Compresses bytes into the gzip format and writes them into the file descriptor through CSVFileSink.
+ * Bytes are collected in the buffer and compressed by big pieces. .finish() ends the gzip stream,
+ * and the destructor finishes it if it hasn't been finished. Doesn't close the descriptor.
+ * Raises std::runtime_error if compression or writing fails.
+ */
+public:
+
+    using size_type = std::string::size_type;
+
+
+    CSVGzipSink(int fd, int level = Z_DEFAULT_COMPRESSION, size_type capacity = 1 << 18) : file{fd, capacity},
+               input(std::max<size_type>(capacity, 1)), output(std::max<size_type>(capacity, 1)) {
+        // level is the zlib compression level from 0 (none) to 9 (best), or -1 for the default 6.
+        // 15 + 16 makes zlib write the gzip header and trailer.
+        if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            throw std::runtime_error("Can't start compression with the level " + std::to_string(level) + ".");
+    }
+
+    CSVGzipSink(const CSVGzipSink&) = delete;
+    CSVGzipSink& operator=(const CSVGzipSink&) = delete;
+
+    ~CSVGzipSink() {
+        try {
+            finish();
+        }
+        catch (...) {}
+        deflateEnd(&stream);
+    }
+
+
+    void write(const char* data, size_type size) {
+        while (size) {
+            auto piece = std::min(size, input.size() - used);
+            std::memcpy(input.data() + used, data, piece);
+            used += piece;
+            data += piece;
+            size -= piece;
+            if (used == input.size())
+                compress(Z_NO_FLUSH);
+        }
+    }
+
+    CSVGzipSink& flush() {
+        // Compresses buffered bytes and writes everything compressed so far. The compressor may keep some bytes for later.
+        compress(Z_NO_FLUSH);
+        file.flush();
+        return *this;
+    }
+
+    CSVGzipSink& finish() {
+        // Compresses everything, writes the gzip trailer and flushes. Nothing can be written after it.
+        if (!finished) {
+            finished = true;
+            compress(Z_FINISH);
+            file.flush();
+        }
+        return *this;
+    }
+
+
+    const CSVFileSink::Stats& stats() const {
+        // Statistics of written compressed bytes.
+        return file.stats();
+    }
+
+
+private:
+    CSVFileSink file;
+    z_stream stream{};
+    std::vector<char> input, output;
+    size_type used = 0;
+    bool finished = false;
+
+
+    void compress(int mode) {
+        // Passes buffered bytes through the compressor and writes its output into the file.
+        stream.next_in = reinterpret_cast<Bytef*>(input.data());
+        stream.avail_in = used;
+
+        int result;
+        do {
+            stream.next_out = reinterpret_cast<Bytef*>(output.data());
+            stream.avail_out = output.size();
+            result = deflate(&stream, mode);
+            if (result == Z_STREAM_ERROR)
+                throw std::runtime_error("Can't compress the data.");
+            file.write(output.data(), output.size() - stream.avail_out);
+        } while (stream.avail_out == 0 || (mode == Z_FINISH && result != Z_STREAM_END));
+
+        used = 0;
+    }
+};
+
+
+class CSVGzipWriter {
+/* Writes content of the CSVData into a gzip compressed file, like CSVWriter.
+ * Rows are encoded on the calling thread, and compressed and written on a background thread through CSVAsyncSink,
+ * unless background is false.
+ */
+public:
+
+    using size_type = CSVGzipSink::size_type;
+
+
+    CSVGzipWriter(CSVData& input, std::string path, std::string delimiter = ",", char quote = '"', int level = Z_DEFAULT_COMPRESSION,
+                  bool background = true) : input{input}, path{path}, delimiter{delimiter}, quote{quote},
+                  fd{::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)} {
+        /* CSVGzipWriter constructor. Writes header.
+         * Arguments:
+         *     input: The data which will be written.
+         *     path: Path to the output file.
+         *     delimiter: The delimiter of the output.
+         *     quote: The quote character.
+         *     level: The zlib compression level from 0 (none) to 9 (best), or -1 for the default 6.
+         *     background: If true, compression runs on a background thread while rows are encoded.
+         * Raises std::runtime_error if the file can't be opened.
+         */
+        if (fd < 0)
+            throw std::runtime_error("Can't open the file \"" + path + "\".");
+        try {
+            gzip = std::make_unique<CSVGzipSink>(fd, level);
+        }
+        catch (...) {
+            ::close(fd);
+            throw;
+        }
+        if (background)
+            async = std::make_unique<CSVAsyncSink<CSVGzipSink>>(*gzip, 1 << 20, 3);
+
+        auto header = input.get_header_line(delimiter, quote) + "\n";
+        put(header.data(), header.size());
+    }
+
+    CSVGzipWriter(const CSVGzipWriter&) = delete;
+    CSVGzipWriter& operator=(const CSVGzipWriter&) = delete;
+
+    ~CSVGzipWriter() {
+        try {
+            close();
+        }
+        catch (...) {}
+    }
+
+
+    template <typename Quoting = QuoteMinimal> CSVGzipWriter& write_all() {
+        // Writes all the data from the input into the output file and closes it.
+        write_batch<Quoting>(input);
+        return close();
+    }
+
+
+    template <typename Quoting = QuoteMinimal> CSVGzipWriter& write_batch(CSVData& batch) {
+        // Writes all rows of the batch into the output file without closing it. The batch should have the same columns as the input.
+        if (fd < 0)
+            throw std::runtime_error("The file stream is closed.");
+
+        auto encoder = batch.encode_content<Quoting>(delimiter, quote);
+        if (async)
+            encoder.encode_all(*async);
+        else
+            encoder.encode_all(*gzip);
+        return *this;
+    }
+
+
+    CSVGzipWriter& close() {
+        // Compresses everything left, writes the gzip trailer and closes the file.
+        if (fd >= 0) {
+            int closed = fd;
+            fd = -1;
+            try {
+                if (async)
+                    async->wait();
+                gzip->finish();
+            }
+            catch (...) {
+                ::close(closed);
+                throw;
+            }
+            if (::close(closed) != 0)
+                throw std::runtime_error("Can't close the file \"" + path + "\".");
+        }
+        return *this;
+    }
+
+
+    const CSVFileSink::Stats& stats() const {
+        // Statistics of written compressed bytes. Call it after .close().
+        return gzip->stats();
+    }
+
+
+private:
+    CSVData& input;
+    const std::string path, delimiter;
+    const char quote;
+    int fd;
+
+    // The compressor, and the background thread which runs it. The thread is stopped before the compressor is destroyed.
+    std::unique_ptr<CSVGzipSink> gzip;
+    std::unique_ptr<CSVAsyncSink<CSVGzipSink>> async;
+
+
+    void put(const char* data, size_type size) {
+        if (async)
+            async->write(data, size);
+        else
+            gzip->write(data, size);
+    }
+};
+
+
+}
+
+
+#endif
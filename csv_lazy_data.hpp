@@ -0,0 +1,283 @@
+// Header with CSVLazyData class.
+
+#ifndef CSV_MANAGER_CSV_LAZY_DATA
+#define CSV_MANAGER_CSV_LAZY_DATA
+
+
+#include <string>
+#include <vector>
+#include <map>
+#include <list>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include "./csv_scanner.hpp"
+
+
+namespace csvm {
+
+
+class CSVLazyData {
+/* Read-only view of a CSV file, which parses rows only when they are accessed.
+ *
+ * On construction, the file is mapped and one pass of CSVCounter finds where rows begin, looking only at line feeds and quotes.
+ * Only the offset of every block_rows-th row is kept. When a row is accessed, its whole block is parsed,
+ * and at most cache_blocks parsed blocks are kept, the least recently used ones are dropped first.
+ * So opening a big file costs one scan without allocations, and memory depends on the cache, not on the file.
+ *
+ * A quote begins a quoted field only at the start of a field, and doubled quotes inside it are one quote. Characters after
+ * the closing quote are added to the field. Rows end with LF or CRLF outside quotes, and line ends inside quotes are kept as they are.
+ * The first row is the header. Rows are padded with empty fields or cut to the number of columns, as CSVReader does.
+ *
+ * References returned by .get_row() are valid until another block is parsed. Works only on POSIX systems.
+ */
+public:
+
+    // Type aliases.
+    using vector_s = std::vector<std::string>;
+    using vector_v_s = std::vector<vector_s>;
+    using index_type = vector_v_s::size_type;
+    using map_s_i = std::map<std::string, index_type>;
+
+
+    struct Stats {
+    // Numbers of row accesses which found their block in the cache and which parsed it.
+        index_type hits = 0;
+        index_type misses = 0;
+    };
+
+
+    CSVLazyData(std::string path, std::string delimiter = ",", char quote = '"', index_type block_rows = 1024, index_type cache_blocks = 64) :
+               file{path}, delimiter{delimiter}, quote{quote}, block_rows{std::max<index_type>(block_rows, 1)},
+               cache_blocks{std::max<index_type>(cache_blocks, 1)}, counter{delimiter, quote} {
+        /* CSVLazyData constructor. Maps the file, reads the header and finds rows.
+         * Arguments:
+         *     path: Path to the CSV file.
+         *     delimiter: The delimiter of the file.
+         *     quote: The quote character.
+         *     block_rows: Number of rows which are parsed at once.
+         *     cache_blocks: Number of parsed blocks which are kept.
+         * Raises std::runtime_error if the file can't be mapped, and std::invalid_argument if the dialect is wrong or column names repeat.
+         */
+        const char* begin = file.data();
+        const char* end = begin + file.size();
+        if (begin == end)
+            return;
+
+        const char* header_end = counter.row_end(begin, end);
+        for (auto& i : parse_row(begin, header_end)) {
+            if (!column_index.emplace(i, columns.size()).second)
+                throw std::invalid_argument("The column \"" + i + "\" is repeated.");
+            columns.push_back(i);
+        }
+
+        for (const char* i = header_end; i != end; i = counter.row_end(i, end)) {
+            if (rows % this->block_rows == 0)
+                block_offsets.push_back(i - begin);
+            ++rows;
+        }
+    }
+
+    CSVLazyData(const CSVLazyData&) = delete;
+    CSVLazyData& operator=(const CSVLazyData&) = delete;
+
+
+    index_type row_number() const {
+        return rows;
+    }
+    index_type column_number() const {
+        return columns.size();
+    }
+
+
+    const vector_s& get_column_names() const {
+        return columns;
+    }
+    const map_s_i& get_column_index() const {
+        return column_index;
+    }
+
+
+    const vector_s& get_row(index_type index) {
+        // Returns the row, parsing its block if it isn't cached. Raises std::invalid_argument if the row index is out of bounds.
+        if (index >= rows)
+            throw std::invalid_argument("The row index \"" + std::to_string(index) + "\" is out of bounds.");
+        return block(index / block_rows)[index % block_rows];
+    }
+
+    const vector_s& operator[](index_type index) {
+        return get_row(index);
+    }
+
+
+    std::string get_field(index_type index, const std::string& column) {
+        // Returns the field of the row in the column. Raises std::invalid_argument if there is no such row or column.
+        return get_row(index)[column_position(column)];
+    }
+
+
+    vector_s get_column(const std::string& column) {
+        // Returns all values of the column, parsing blocks one after another. Raises std::invalid_argument if there is no such column.
+        auto position = column_position(column);
+        vector_s output;
+        output.reserve(rows);
+        for (index_type i = 0; i < block_offsets.size(); ++i)
+            for (auto& row : block(i))
+                output.push_back(row[position]);
+        return output;
+    }
+
+
+    index_type cached_blocks() const {
+        return cache.size();
+    }
+
+    const Stats& stats() const {
+        return statistics;
+    }
+
+
+private:
+    CSVMappedFile file;
+    std::string delimiter;
+    char quote;
+    index_type block_rows, cache_blocks;
+
+    // Finds ends of rows.
+    CSVCounter counter;
+
+    // Columns of the header.
+    vector_s columns;
+    map_s_i column_index;
+
+    // The number of rows without the header, and offsets of the first rows of blocks.
+    index_type rows = 0;
+    std::vector<std::uint64_t> block_offsets;
+
+    // Parsed blocks by their numbers, and numbers of blocks from the most recently used.
+    struct Block {
+        vector_v_s rows;
+        std::list<index_type>::iterator position;
+    };
+    std::unordered_map<index_type, Block> cache;
+    std::list<index_type> recent;
+
+    Stats statistics;
+
+
+    index_type column_position(const std::string& column) const {
+        auto found = column_index.find(column);
+        if (found == column_index.end())
+            throw std::invalid_argument("A column with name \"" + column + "\" doesn't exists.");
+        return found->second;
+    }
+
+
+    const char* find_delimiter(const char* begin, const char* end) const {
+        // Returns the position of the delimiter, or end.
+        while ((begin = static_cast<const char*>(std::memchr(begin, delimiter[0], end - begin)))) {
+            if (static_cast<index_type>(end - begin) >= delimiter.size() && std::memcmp(begin, delimiter.data(), delimiter.size()) == 0)
+                return begin;
+            ++begin;
+        }
+        return end;
+    }
+
+
+    void parse_row(const char* begin, const char* end, vector_s& output) const {
+        // Parses the row from its begin to the position after its line end into fields. The output keeps the storage of its strings.
+        if (end != begin && end[-1] == '\n') {
+            --end;
+            if (end != begin && end[-1] == '\r')
+                --end;
+        }
+
+        index_type number = 0;
+        for (const char* i = begin;; ++number) {
+            if (number == output.size())
+                output.emplace_back();
+            auto& field = output[number];
+            field.clear();
+
+            if (i != end && *i == quote) {
+                // The quoted part, in which doubled quotes are one quote.
+                for (const char* j = i + 1;;) {
+                    auto next = static_cast<const char*>(std::memchr(j, quote, end - j));
+                    if (!next) {
+                        field.append(j, end);
+                        i = end;
+                        break;
+                    }
+                    field.append(j, next);
+                    if (next + 1 != end && next[1] == quote) {
+                        field += quote;
+                        j = next + 2;
+                        continue;
+                    }
+                    i = next + 1;
+                    break;
+                }
+            }
+
+            auto delimiter_position = find_delimiter(i, end);
+            field.append(i, delimiter_position);
+            if (delimiter_position == end)
+                break;
+            i = delimiter_position + delimiter.size();
+        }
+        output.resize(number + 1);
+    }
+
+    vector_s parse_row(const char* begin, const char* end) const {
+        vector_s output;
+        parse_row(begin, end, output);
+        return output;
+    }
+
+
+    const vector_v_s& block(index_type number) {
+        // Returns the parsed block, parsing it if it isn't cached, and dropping the least recently used block if the cache is full.
+        auto found = cache.find(number);
+        if (found != cache.end()) {
+            recent.splice(recent.begin(), recent, found->second.position);
+            ++statistics.hits;
+            return found->second.rows;
+        }
+        ++statistics.misses;
+
+        // The storage of the dropped block is reused.
+        vector_v_s output;
+        if (cache.size() >= cache_blocks) {
+            auto dropped = cache.find(recent.back());
+            output.swap(dropped->second.rows);
+            cache.erase(dropped);
+            recent.pop_back();
+        }
+
+        const char* end = file.data() + file.size();
+        const char* i = file.data() + block_offsets[number];
+        index_type size = std::min(block_rows, rows - number * block_rows);
+        output.resize(size);
+        for (auto& row : output) {
+            const char* next = counter.row_end(i, end);
+            parse_row(i, next, row);
+            row.resize(columns.size());
+            i = next;
+        }
+
+        recent.push_front(number);
+        auto& inserted = cache[number];
+        inserted.rows.swap(output);
+        inserted.position = recent.begin();
+        return inserted.rows;
+    }
+};
+
+
+}
+
+
+#endif
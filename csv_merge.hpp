@@ -0,0 +1,220 @@
+// Header with CSVMerger class.
+
+#ifndef CSV_MANAGER_CSV_MERGE
+#define CSV_MANAGER_CSV_MERGE
+
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+
+#include "./csv_data.hpp"
+#include "./csv_reader.hpp"
+#include "./csv_writer.hpp"
+
+
+namespace csvm {
+
+
+class CSVMerger {
+/* Merges CSV files, each already sorted by key columns, into one sorted output file.
+ *
+ * Every input is read by a CSVReader in batches of batch_rows rows, and a loser tree picks the smallest current row.
+ * Rows are swapped between input batches and the output batch, so their storage is reused,
+ * and memory depends only on the number of inputs and the batch size.
+ *
+ * Rows are compared by their key fields as strings, one key after another. Equal rows are taken from inputs
+ * in their order, so the merge is stable. All inputs must have the same columns, which are written as the output header.
+ */
+public:
+
+    // Type aliases.
+    using vector_s = std::vector<std::string>;
+    using vector_v_s = std::vector<vector_s>;
+    using size_type = vector_v_s::size_type;
+
+
+    // Member classes.
+
+
+    class LoserTree {
+    /* Tournament tree which finds the smallest current row among sources.
+     * Internal nodes keep losers of their matches, and the node 0 keeps the overall winner.
+     * Exhausted sources are greater than any row, and equal rows are ordered by the source index.
+     */
+    public:
+
+        LoserTree(std::vector<const vector_s*>& current, const std::vector<size_type>& keys) : current{current}, keys{keys},
+                 tree(current.size()) {
+            // Takes current rows of sources, null for exhausted ones, and indexes of key fields.
+            if (!tree.empty())
+                tree[0] = build(1);
+        }
+
+        size_type winner() const {
+            return tree[0];
+        }
+
+        void replay() {
+            // Replays matches from the leaf of the winner to the root after the winner has changed its row.
+            auto winner = tree[0];
+            for (auto node = (winner + tree.size()) / 2; node > 0; node /= 2)
+                if (less(tree[node], winner))
+                    std::swap(tree[node], winner);
+            tree[0] = winner;
+        }
+
+    private:
+        std::vector<const vector_s*>& current;
+        const std::vector<size_type>& keys;
+        std::vector<size_type> tree;
+
+        size_type build(size_type node) {
+            // Plays matches of a subtree and returns its winner. Leaves are nodes from size to size * 2.
+            if (node >= tree.size())
+                return node - tree.size();
+
+            auto left = build(node * 2), right = build(node * 2 + 1);
+            if (less(left, right)) {
+                tree[node] = right;
+                return left;
+            }
+            tree[node] = left;
+            return right;
+        }
+
+        bool less(size_type left, size_type right) const {
+            if (!current[left])
+                return false;
+            if (!current[right])
+                return true;
+            for (auto k : keys) {
+                auto order = (*current[left])[k].compare((*current[right])[k]);
+                if (order != 0)
+                    return order < 0;
+            }
+            return left < right;
+        }
+    };
+
+
+    // Attributes and methods.
+
+
+    CSVMerger(vector_s input_paths, std::string output_path, vector_s key_columns, std::string sep = ",", char quote = '"',
+              size_type batch_rows = 1024) : input_paths{input_paths}, output_path{output_path}, key_columns{key_columns},
+              sep{sep}, quote{quote}, batch_rows{std::max<size_type>(batch_rows, 1)} {
+        /* CSVMerger constructor.
+         * Arguments:
+         *     input_paths: Paths to the sorted CSV files.
+         *     output_path: Path to the file in which merged rows will be written. Must differ from input paths.
+         *     key_columns: Names of columns by which inputs are sorted, from the most significant.
+         *     sep: The separator used in inputs and the output.
+         *     quote: The quote character.
+         *     batch_rows: Number of rows read from every input, and written into the output, at once.
+         */
+    }
+
+
+    CSVMerger& merge() {
+        // Merges inputs into the output. Raises std::runtime_error if files can't be opened,
+        // and std::invalid_argument if inputs have different columns or there is no such key column.
+        if (input_paths.empty())
+            throw std::invalid_argument("There are no files to merge.");
+
+        std::vector<std::unique_ptr<Source>> sources;
+        for (auto& i : input_paths) {
+            if (!std::ifstream(i))
+                throw std::runtime_error("Can't open the file \"" + i + "\".");
+
+            sources.push_back(std::make_unique<Source>());
+            auto& source = *sources.back();
+            source.reader = std::make_unique<CSVReader>(source.header, i, sep, quote);
+
+            if (source.header.get_column_index() != sources[0]->header.get_column_index())
+                throw std::invalid_argument("The file \"" + i + "\" has different columns.");
+        }
+
+        auto& header = sources[0]->header;
+        auto keys = key_indexes(header);
+
+        std::vector<const vector_s*> current;
+        for (auto& i : sources)
+            current.push_back(i->next_batch(batch_rows));
+
+        CSVData output;
+        output.get_column_index() = header.get_column_index();
+        auto& output_rows = output.get_values();
+        output_rows.resize(batch_rows);
+        size_type output_number = 0;
+
+        CSVWriter writer(header, output_path, sep, quote);
+
+        LoserTree tree(current, keys);
+        while (current[tree.winner()]) {
+            auto& source = *sources[tree.winner()];
+            output_rows[output_number++].swap(source.batch.get_values()[source.position]);
+
+            current[tree.winner()] = ++source.position < source.batch.row_number() ? &source.batch.get_values()[source.position] :
+                                                                                       source.next_batch(batch_rows);
+            tree.replay();
+
+            if (output_number == batch_rows) {
+                writer.write_batch(output);
+                output_number = 0;
+            }
+        }
+
+        output_rows.resize(output_number);
+        writer.write_batch(output).close();
+
+        return *this;
+    }
+
+
+private:
+    // Files, keys and settings.
+    vector_s input_paths;
+    std::string output_path;
+    vector_s key_columns;
+    std::string sep;
+    char quote;
+    size_type batch_rows;
+
+
+    struct Source {
+    // One input with its current batch.
+        CSVData header, batch;
+        std::unique_ptr<CSVReader> reader;
+        size_type position = 0;
+
+        const vector_s* next_batch(size_type rows) {
+            // Reads the next batch and returns its first row, or null if the input has ended.
+            position = 0;
+            return reader->read_batch(batch, rows) ? &batch.get_values()[0] : nullptr;
+        }
+    };
+
+
+    std::vector<size_type> key_indexes(CSVData& header) {
+        // Finds indexes of key columns.
+        std::vector<size_type> output;
+        auto& index = header.get_column_index();
+        for (auto& i : key_columns) {
+            auto found = index.find(i);
+            if (found == index.end())
+                throw std::invalid_argument("A column with name \"" + i + "\" doesn't exists.");
+            output.push_back(found->second);
+        }
+        return output;
+    }
+};
+
+
+}
+
+
+#endif
@@ -6,6 +6,7 @@
 
 #include <vector>
 #include <string>
+#include <utility>
 #include <stdexcept>
 
 
@@ -53,16 +54,22 @@ public:
         // Current row.
         vector_s row;
 
+        // Offset of the current row from the start of the source, and of the next line: characters of all lines before it,
+        // plus one line feed for every line. For a file read line by line, it's the byte offset of the row in the file.
+        size_type row_position = 0;
+        size_type line_position = 0;
+
         Parser(const IterStr &begin, const IterStr &end, std::string del = ",", char quote = '\"') : delimiter{del}, quote{quote},
               source_begin{begin}, source_end{end} {
             // The normal parser construction.
         }
 
 
-        void reset(IterStr begin) {
-            // Resets parser with a new iterator.
+        void reset(IterStr begin, size_type position = 0) {
+            // Resets parser with a new iterator. position is the offset of its first line.
             source_begin = begin;
             ended = false;
+            line_position = position;
         }
 
 
@@ -76,12 +83,15 @@ public:
             current_state = &Parser::start_state;
             delim_count = 0;
             buffer = "";
-            row = {};
+            row.clear();
+            row_position = line_position;
 
             // While the iterator of lines is not ended.
             while (source_begin != source_end) {
                 // Iteration of characters in a line and increment of the iterator of lines.
-                for (char i : *source_begin++) {
+                auto&& line = *source_begin++;
+                line_position += line.size() + 1;
+                for (char i : line) {
                     // Use of the current state function on this character.
                     (this->*current_state)(i);
                 }
@@ -89,7 +99,7 @@ public:
                 // If record has ended.
                 if (current_state != enclosed_state_pointer) {
                     // Push the content of the last field into the row and stop the execution.
-                    row.push_back(buffer);
+                    row.push_back(std::move(buffer));
                     return;
                 }
 
@@ -98,7 +108,7 @@ public:
             }
 
             // If source_begin == source_end, then it is the end.
-            row.push_back(buffer);
+            row.push_back(std::move(buffer));
             ended = true;
         }
 
@@ -123,11 +133,9 @@ public:
 
         void use_full_delimiter() {
             // Ends the current field and starts a new one. Should be used when the delimiter is full.
-            std::string out;
-
-            for (auto begin = buffer.begin(), end = buffer.end() - delimiter_size; begin != end; ++begin)
-                out += *begin;
-            row.push_back(out);
+            // The field is moved into the row without the delimiter.
+            buffer.resize(buffer.size() - delimiter_size);
+            row.push_back(std::move(buffer));
 
             buffer = "";
             delim_count = 0;
@@ -247,8 +255,9 @@ public:
 
         Iterator& operator++() {
             // Makes one iteration and returns the reference to the self.
+            // Rows are swapped with the parser, which clears its row before parsing, so no row is copied.
             parser->next();
-            row = parser->row;
+            row.swap(parser->row);
             return *this;
         }
 
@@ -256,7 +265,7 @@ public:
             // Makes one iteration and returns a copy of self from before the iteration.
             auto copy = *this;
             parser->next();
-            row = parser->row;
+            row.swap(parser->row);
             return copy;
         }
 
@@ -265,6 +274,11 @@ public:
             return row;
         }
 
+        vector_s& operator*() {
+            // Returns the reference to the current row, which may be moved from before the next iteration.
+            return row;
+        }
+
         operator bool() const {
             return parser->ended;
         }
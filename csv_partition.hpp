@@ -0,0 +1,347 @@
+// Header with CSVPartitionWriter class.
+
+#ifndef CSV_MANAGER_CSV_PARTITION
+#define CSV_MANAGER_CSV_PARTITION
+
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <filesystem>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "./csv_data.hpp"
+#include "./csv_encoder.hpp"
+#include "./csv_sink.hpp"
+#include "./csv_thread_pool.hpp"
+
+
+namespace csvm {
+
+
+class CSVPartitionWriter {
+/* Splits rows of a CSVData into many CSV files in a directory. Every file is encoded and written by its own task on the pool.
+ *
+ * .write_hashed() puts every row into one of a fixed number of files by the hash of its key field.
+ * .write_by_value() puts rows with the same value of the partition column into the Hive-style directory "column=value",
+ * and drops the partition column from them, since it's known from the path.
+ * .write_split() cuts rows in their order into files with at most the given number of rows or bytes.
+ *
+ * Files are named "part-00000.csv", and every file starts with the header. Rows keep their order inside a file.
+ * Rows aren't copied: every file is encoded straight from the input by its row indexes.
+ */
+public:
+
+    // Type aliases.
+    using vector_s = std::vector<std::string>;
+    using vector_v_s = std::vector<vector_s>;
+    using size_type = vector_v_s::size_type;
+
+
+    CSVPartitionWriter(CSVData& input, std::string directory, std::string delimiter = ",", char quote = '"', unsigned threads = 0,
+                       std::size_t buffer_size = 1 << 20) : input{input}, directory{directory}, delimiter{delimiter}, quote{quote},
+                       buffer_size{buffer_size}, pool{threads} {
+        /* CSVPartitionWriter constructor.
+         * Arguments:
+         *     input: The data which will be split.
+         *     directory: The directory in which files are written. It's created if it doesn't exist.
+         *     delimiter: The delimiter of output files.
+         *     quote: The quote character.
+         *     threads: Number of threads which write files. If 0, the number of hardware threads is used.
+         *     buffer_size: Size of the write buffer of every file in bytes.
+         */
+    }
+
+
+    vector_s write_hashed(std::string column, size_type partitions) {
+        // Writes every row into the file with number hash(value of the column) % partitions and returns paths of all files,
+        // including empty ones. The hash is FNV-1a, so the same key goes into the same file on every platform.
+        // Raises std::invalid_argument if there is no such column or partitions is 0.
+        if (partitions == 0)
+            throw std::invalid_argument("The number of partitions must be positive.");
+        auto key = column_position(column);
+
+        std::vector<Partition> output(partitions);
+        auto& rows = input.get_values();
+        for (size_type i = 0; i < rows.size(); ++i)
+            output[hash(rows[i][key]) % partitions].rows.push_back(i);
+
+        for (size_type i = 0; i < partitions; ++i)
+            output[i].path = file_path(directory, i);
+
+        return write_partitions(output, none);
+    }
+
+
+    vector_s write_by_value(std::string column) {
+        // Writes rows with every value of the column into "directory/column=value/part-00000.csv" and returns paths of files,
+        // in the order of the first appearance of values. Special characters of the column and values are escaped as %XX,
+        // and the empty value becomes "__HIVE_DEFAULT_PARTITION__". Raises std::invalid_argument if there is no such column.
+        auto key = column_position(column);
+
+        std::vector<Partition> output;
+        std::unordered_map<std::string, size_type> numbers;
+        auto& rows = input.get_values();
+        for (size_type i = 0; i < rows.size(); ++i) {
+            auto found = numbers.try_emplace(rows[i][key], output.size());
+            if (found.second) {
+                output.emplace_back();
+                auto name = escape(column) + "=" + (rows[i][key].empty() ? "__HIVE_DEFAULT_PARTITION__" : escape(rows[i][key]));
+                output.back().path = file_path(std::filesystem::path(directory) / name, 0);
+            }
+            output[found.first->second].rows.push_back(i);
+        }
+
+        return write_partitions(output, key);
+    }
+
+
+    vector_s write_split(size_type max_rows, std::size_t max_bytes = 0) {
+        // Cuts rows in their order into files of at most max_rows rows and max_bytes bytes with the header, and returns paths of files.
+        // 0 means no limit, but at least one limit must be set. A row bigger than max_bytes gets a file of its own.
+        // Encoded sizes of rows are computed in parallel when there is a byte limit. Raises std::invalid_argument if there are no limits.
+        if (max_rows == 0 && max_bytes == 0)
+            throw std::invalid_argument("At least one limit of the file size must be set.");
+
+        auto& rows = input.get_values();
+        std::vector<std::size_t> sizes;
+        if (max_bytes)
+            sizes = encoded_sizes();
+        auto header_size = header(none).size();
+
+        std::vector<Partition> output;
+        std::size_t bytes = 0;
+        for (size_type i = 0; i < rows.size(); ++i) {
+            auto size = max_bytes ? sizes[i] : 0;
+            if (output.empty() || (max_rows && output.back().rows.size() == max_rows) ||
+                (max_bytes && !output.back().rows.empty() && bytes + size > max_bytes)) {
+                output.emplace_back();
+                output.back().path = file_path(directory, output.size() - 1);
+                bytes = header_size;
+            }
+            output.back().rows.push_back(i);
+            bytes += size;
+        }
+
+        return write_partitions(output, none);
+    }
+
+
+private:
+    // The input, the output directory and settings.
+    CSVData& input;
+    std::string directory, delimiter;
+    char quote;
+    std::size_t buffer_size;
+
+    // Workers which write files.
+    CSVThreadPool pool;
+
+    static constexpr size_type none = static_cast<size_type>(-1);
+
+
+    struct Partition {
+    // One output file and indexes of its rows.
+        std::string path;
+        std::vector<size_type> rows;
+    };
+
+
+    class Fields {
+    // Fields of one row without the skipped one, which are iterated by the encoder.
+    public:
+
+        class Iterator {
+        public:
+            Iterator(const std::string* field, const std::string* skipped) : field{field}, skipped{skipped} {
+                if (field == skipped)
+                    ++this->field;
+            }
+
+            const std::string& operator*() const {
+                return *field;
+            }
+
+            Iterator& operator++() {
+                if (++field == skipped)
+                    ++field;
+                return *this;
+            }
+
+            bool operator!=(const Iterator& right) const {
+                return field != right.field;
+            }
+
+        private:
+            const std::string* field;
+            const std::string* skipped;
+        };
+
+
+        Fields(const vector_s& row, size_type skipped) : row{row}, skipped{skipped < row.size() ? row.data() + skipped : nullptr} {}
+
+        Iterator begin() const {
+            return Iterator(row.data(), skipped);
+        }
+
+        Iterator end() const {
+            return Iterator(row.data() + row.size(), nullptr);
+        }
+
+    private:
+        const vector_s& row;
+        const std::string* skipped;
+    };
+
+
+    class RowIterator {
+    // Iterates rows of the input by their indexes, yielding their fields without the skipped one.
+    public:
+        RowIterator(const vector_v_s& rows, const size_type* index, size_type skipped) : rows{&rows}, index{index}, skipped{skipped} {}
+
+        Fields operator*() const {
+            return Fields((*rows)[*index], skipped);
+        }
+
+        RowIterator& operator++() {
+            ++index;
+            return *this;
+        }
+
+        bool operator==(const RowIterator& right) const {
+            return index == right.index;
+        }
+        bool operator!=(const RowIterator& right) const {
+            return index != right.index;
+        }
+
+    private:
+        const vector_v_s* rows;
+        const size_type* index;
+        size_type skipped;
+    };
+
+
+    size_type column_position(const std::string& column) {
+        // Finds the index of the column.
+        auto& index = input.get_column_index();
+        auto found = index.find(column);
+        if (found == index.end())
+            throw std::invalid_argument("A column with name \"" + column + "\" doesn't exists.");
+        return found->second;
+    }
+
+
+    std::string header(size_type skipped) {
+        // Encodes the header line without the skipped column.
+        vector_v_s names = {input.get_column_names()};
+        if (skipped != none)
+            names[0].erase(names[0].begin() + skipped);
+        CSVBufferSink output;
+        CSVEncoder<vector_v_s::iterator>(names.begin(), names.end(), delimiter, quote).encode_all(output);
+        return std::move(output.buffer);
+    }
+
+
+    std::vector<std::size_t> encoded_sizes() {
+        // Computes encoded sizes of all rows with line ends, by blocks on workers.
+        auto& rows = input.get_values();
+        std::vector<std::size_t> output(rows.size());
+        size_type block = 65536, blocks = (rows.size() + block - 1) / block;
+
+        pool.for_each(blocks, [&](size_type i) {
+            auto begin = rows.begin() + i * block, end = rows.begin() + std::min(rows.size(), (i + 1) * block);
+            auto sizes = CSVEncoder<vector_v_s::iterator>(begin, end, delimiter, quote).encoded_sizes();
+            std::copy(sizes.begin(), sizes.end(), output.begin() + i * block);
+        });
+
+        return output;
+    }
+
+
+    vector_s write_partitions(std::vector<Partition>& partitions, size_type skipped) {
+        // Writes every partition into its file on workers and returns paths of files.
+        auto header_line = header(skipped);
+        auto& rows = input.get_values();
+
+        for (auto& i : partitions)
+            std::filesystem::create_directories(std::filesystem::path(i.path).parent_path());
+
+        pool.for_each(partitions.size(), [&](size_type i) {
+            auto& partition = partitions[i];
+
+            int fd = ::open(partition.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0)
+                throw std::runtime_error("Can't open the file \"" + partition.path + "\".");
+
+            try {
+                CSVFileSink sink(fd, buffer_size);
+                sink.write(header_line.data(), header_line.size());
+                auto* indexes = partition.rows.data();
+                CSVEncoder<RowIterator>(RowIterator(rows, indexes, skipped), RowIterator(rows, indexes + partition.rows.size(), skipped),
+                                        delimiter, quote).encode_all(sink);
+                sink.close();
+            }
+            catch (...) {
+                ::close(fd);
+                throw;
+            }
+            if (::close(fd) != 0)
+                throw std::runtime_error("Can't close the file \"" + partition.path + "\".");
+        });
+
+        vector_s output;
+        for (auto& i : partitions)
+            output.push_back(i.path);
+        return output;
+    }
+
+
+    static std::string file_path(const std::filesystem::path& directory, size_type number) {
+        // Returns the path of the file with the number in the directory.
+        char name[32];
+        std::snprintf(name, sizeof(name), "part-%05zu.csv", number);
+        return (directory / name).string();
+    }
+
+
+    static std::string escape(const std::string& value) {
+        // Escapes characters which Hive escapes in partition paths as %XX.
+        static const std::string special = "\"#%'*/:=?\\{[]^";
+        static const char digits[] = "0123456789ABCDEF";
+        std::string output;
+        for (unsigned char c : value) {
+            if (c < 0x20 || c == 0x7F || special.find(c) != std::string::npos) {
+                output += '%';
+                output += digits[c >> 4];
+                output += digits[c & 15];
+            }
+            else
+                output += c;
+        }
+        return output;
+    }
+
+
+    static std::uint64_t hash(const std::string& value) {
+        // FNV-1a hash of the value.
+        std::uint64_t output = 14695981039346656037ull;
+        for (unsigned char c : value) {
+            output ^= c;
+            output *= 1099511628211ull;
+        }
+        return output;
+    }
+};
+
+
+}
+
+
+#endif
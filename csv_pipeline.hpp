@@ -0,0 +1,413 @@
+// Header with CSVPipeline class and CSVRingQueue, the queue between its stages.
+
+#ifndef CSV_MANAGER_CSV_PIPELINE
+#define CSV_MANAGER_CSV_PIPELINE
+
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <streambuf>
+#include <functional>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+
+#include "./csv_data.hpp"
+#include "./csv_encoder.hpp"
+#include "./csv_reader.hpp"
+#include "./csv_writer.hpp"
+
+
+namespace csvm {
+
+
+template <typename T> class CSVRingQueue {
+/* Bounded queue for exactly one producer thread and one consumer thread, without locks.
+ * The producer only moves the tail and the consumer only moves the head, so each index has one writer,
+ * and they are kept on separate cache lines. .try_push() fails when the queue is full, and .try_pop() when it's empty.
+ */
+public:
+
+    using size_type = typename std::vector<T>::size_type;
+
+
+    CSVRingQueue(size_type capacity) : slots(std::max<size_type>(capacity, 1) + 1) {}
+
+    CSVRingQueue(const CSVRingQueue&) = delete;
+    CSVRingQueue& operator=(const CSVRingQueue&) = delete;
+
+
+    bool try_push(T& value) {
+        // Moves the value into the queue if there is space. Called only by the producer.
+        auto position = tail.load(std::memory_order_relaxed), next = (position + 1) % slots.size();
+        if (next == head.load(std::memory_order_acquire))
+            return false;
+        slots[position] = std::move(value);
+        tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& value) {
+        // Moves the first value out of the queue if there is one. Called only by the consumer.
+        auto position = head.load(std::memory_order_relaxed);
+        if (position == tail.load(std::memory_order_acquire))
+            return false;
+        value = std::move(slots[position]);
+        head.store((position + 1) % slots.size(), std::memory_order_release);
+        return true;
+    }
+
+
+private:
+    // One slot is always empty, so a full queue differs from an empty one.
+    std::vector<T> slots;
+    alignas(64) std::atomic<size_type> head{0};
+    alignas(64) std::atomic<size_type> tail{0};
+};
+
+
+class CSVPipeline {
+/* Streams rows of a CSV file through stages into a sink, without loading the whole table.
+ *
+ * The source is a CSVReader, which reads rows in batches of batch_rows rows. Stages are added with .map(), .filter() and .project(),
+ * and are applied to every batch in their order. .write() sends the result into a CSV file through CSVWriter, and .for_each()
+ * into a callback. A pipeline runs only once, like its reader.
+ *
+ * In the threaded mode, the source and every stage run on threads of their own, and the sink on the calling thread.
+ * Batches go between them through CSVRingQueue, and then back to the source, so at most queue_batches batches exist at once.
+ * A thread which finds its queue full or empty spins briefly, and then sleeps on the condition variable of the queue,
+ * so stages which wait for I/O don't use CPU.
+ * An exception thrown by any stage or the sink stops all threads and is rethrown by the run.
+ *
+ *     CSVPipeline("in.csv").filter(keep).map(fix).project({"Id", "Name"}).write("out.csv");
+ */
+public:
+
+    // Type aliases.
+    using vector_s = std::vector<std::string>;
+    using vector_v_s = std::vector<vector_s>;
+    using size_type = vector_v_s::size_type;
+
+    using map_function = std::function<void(vector_s&)>;
+    using filter_function = std::function<bool(const vector_s&)>;
+    using batch_function = std::function<void(vector_v_s&)>;
+
+
+    CSVPipeline(std::string path, std::string sep = ",", char quote = '"', size_type batch_rows = 4096, size_type queue_batches = 4) :
+               source{header, path, sep, quote}, batch_rows{std::max<size_type>(batch_rows, 1)},
+               queue_batches{std::max<size_type>(queue_batches, 2)}, columns{header.get_column_names()} {
+        /* CSVPipeline constructor. Reads the header of the file.
+         * Arguments:
+         *     path: Path to the input CSV file.
+         *     sep: The separator of the input.
+         *     quote: The quote character of the input.
+         *     batch_rows: Number of rows which are read and passed between stages at once.
+         *     queue_batches: Number of batches which exist at once in the threaded mode.
+         */
+    }
+
+    CSVPipeline(std::unique_ptr<std::streambuf> input, std::string sep = ",", char quote = '"', size_type batch_rows = 4096,
+                size_type queue_batches = 4) : source{header, std::move(input), sep, quote}, batch_rows{std::max<size_type>(batch_rows, 1)},
+               queue_batches{std::max<size_type>(queue_batches, 2)}, columns{header.get_column_names()} {
+        // Reads from the stream buffer instead of a file, for example from CSVGzipInput of "csv_gzip.hpp".
+    }
+
+    CSVPipeline(const CSVPipeline&) = delete;
+    CSVPipeline& operator=(const CSVPipeline&) = delete;
+
+
+    const vector_s& get_column_names() const {
+        // Returns columns of rows after all added stages.
+        return columns;
+    }
+
+
+    CSVPipeline& map(map_function function) {
+        // Adds a stage which changes every row in place. It must keep the number of fields.
+        stages.push_back([function](vector_v_s& rows) {
+            for (auto& i : rows)
+                function(i);
+        });
+        return *this;
+    }
+
+
+    CSVPipeline& filter(filter_function function) {
+        // Adds a stage which keeps only rows for which the function returns true.
+        stages.push_back([function](vector_v_s& rows) {
+            rows.erase(std::remove_if(rows.begin(), rows.end(), [&function](const vector_s& row) {return !function(row);}), rows.end());
+        });
+        return *this;
+    }
+
+
+    CSVPipeline& project(vector_s names) {
+        // Adds a stage which keeps only the given columns in the given order. Fields are moved, not copied.
+        // Raises std::invalid_argument if there is no such column or a column is given twice.
+        std::vector<size_type> positions;
+        for (auto& name : names) {
+            auto found = std::find(columns.begin(), columns.end(), name);
+            if (found == columns.end())
+                throw std::invalid_argument("A column with name \"" + name + "\" doesn't exists.");
+            if (std::find(names.begin(), names.end(), name) != names.begin() + positions.size())
+                throw std::invalid_argument("The column \"" + name + "\" is projected twice.");
+            positions.push_back(found - columns.begin());
+        }
+
+        stages.push_back([positions](vector_v_s& rows) {
+            vector_s projected(positions.size());
+            for (auto& row : rows) {
+                for (size_type i = 0; i < positions.size(); ++i)
+                    projected[i] = std::move(row[positions[i]]);
+                row.swap(projected);
+                projected.resize(positions.size());
+            }
+        });
+        columns = std::move(names);
+        return *this;
+    }
+
+
+    size_type for_each_batch(batch_function sink, bool threaded = true) {
+        // Runs the pipeline and passes every batch after all stages to the sink. Returns the number of rows passed to the sink.
+        // The sink may change batches. Raises std::runtime_error if the pipeline has already run.
+        if (started)
+            throw std::runtime_error("The pipeline has already run.");
+        started = true;
+
+        if (threaded)
+            return run_threaded(sink);
+
+        size_type number = 0;
+        CSVData batch;
+        while (source.read_batch(batch, batch_rows)) {
+            auto& rows = batch.get_values();
+            for (auto& stage : stages)
+                stage(rows);
+            number += rows.size();
+            if (!rows.empty())
+                sink(rows);
+        }
+        return number;
+    }
+
+
+    size_type for_each(std::function<void(vector_s&)> sink, bool threaded = true) {
+        // Runs the pipeline and passes every row after all stages to the sink. Returns the number of rows.
+        return for_each_batch([&sink](vector_v_s& rows) {
+            for (auto& i : rows)
+                sink(i);
+        }, threaded);
+    }
+
+
+    template <typename Quoting = QuoteMinimal> size_type write(std::string path, std::string delimiter = ",", char quote = '"',
+                                                               bool threaded = true) {
+        // Runs the pipeline and writes the result into the CSV file with CSVWriter. Returns the number of written rows.
+        // Quoting is the quoting policy of rows from "csv_encoder.hpp".
+        CSVData output;
+        for (auto& i : columns)
+            output.add_column(i);
+
+        CSVWriter writer(output, path, delimiter, quote);
+        auto number = for_each_batch([&output, &writer](vector_v_s& rows) {
+            output.get_values().swap(rows);
+            writer.write_batch<Quoting>(output);
+            output.get_values().swap(rows);
+        }, threaded);
+        writer.close();
+        return number;
+    }
+
+
+private:
+    // The header of the input, the reader, and settings.
+    CSVData header;
+    CSVReader source;
+    size_type batch_rows, queue_batches;
+
+    // Stages in their order, and columns after them.
+    std::vector<batch_function> stages;
+    vector_s columns;
+    bool started = false;
+
+
+    using Queue = CSVRingQueue<CSVData*>;
+
+
+    class Stopped {
+    // Thrown inside threads when another thread has failed.
+    };
+
+
+    struct Channel {
+    // The queue between two threads, and what its waiting thread sleeps on.
+        Queue queue;
+        std::mutex mutex;
+        std::condition_variable changed;
+        // Number of threads which sleep or are going to sleep on the queue.
+        std::atomic<int> waiting{0};
+
+        Channel(size_type capacity) : queue{capacity} {}
+    };
+
+
+    struct Control {
+    // The state shared by threads of one run.
+        std::atomic<bool> failed{false};
+        std::mutex mutex;
+        std::exception_ptr error;
+        std::vector<std::unique_ptr<Channel>> channels;
+
+        // Number of attempts before a thread sleeps.
+        static constexpr int spins = 64;
+
+        Channel& add_channel(size_type capacity) {
+            channels.push_back(std::make_unique<Channel>(capacity));
+            return *channels.back();
+        }
+
+        void fail(std::exception_ptr exception) {
+            // Saves the first exception, stops all threads and wakes the sleeping ones.
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error)
+                    error = exception;
+                failed.store(true, std::memory_order_release);
+            }
+            for (auto& i : channels) {
+                std::lock_guard<std::mutex> lock(i->mutex);
+                i->changed.notify_all();
+            }
+        }
+
+        void push(Channel& channel, CSVData* batch) {
+            // Waits until the queue has space.
+            wait(channel, [&channel, &batch]() {return channel.queue.try_push(batch);});
+        }
+
+        CSVData* pop(Channel& channel) {
+            // Waits until the queue has a batch.
+            CSVData* output;
+            wait(channel, [&channel, &output]() {return channel.queue.try_pop(output);});
+            return output;
+        }
+
+    private:
+        template <typename F> void wait(Channel& channel, F attempt) {
+            // Calls attempt until it succeeds, spinning first and then sleeping, and wakes the other side of the queue after it.
+            // Both sides change the waiting counter with read-modify-writes after their queue operation, and the later one reads
+            // from the earlier one. So either the sleeper sees the change of the queue, or the other side sees the sleeper
+            // and notifies it under the mutex.
+            bool done = false;
+            for (int i = 0; i < spins && !done; ++i) {
+                if (failed.load(std::memory_order_acquire))
+                    throw Stopped();
+                done = attempt();
+            }
+
+            if (!done) {
+                channel.waiting.fetch_add(1, std::memory_order_acq_rel);
+                std::unique_lock<std::mutex> lock(channel.mutex);
+                while (!(done = attempt()) && !failed.load(std::memory_order_acquire))
+                    channel.changed.wait(lock);
+                channel.waiting.fetch_sub(1, std::memory_order_relaxed);
+                if (!done)
+                    throw Stopped();
+            }
+
+            if (channel.waiting.fetch_add(0, std::memory_order_acq_rel)) {
+                std::lock_guard<std::mutex> lock(channel.mutex);
+                channel.changed.notify_all();
+            }
+        }
+    };
+
+
+    template <typename F> static std::thread start(Control& control, F function) {
+        // Starts a thread which reports its exception to the control.
+        return std::thread([&control, function]() {
+            try {
+                function();
+            }
+            catch (const Stopped&) {}
+            catch (...) {
+                control.fail(std::current_exception());
+            }
+        });
+    }
+
+
+    size_type run_threaded(batch_function& sink) {
+        // queues[i] goes into the stage i, the last one into the sink, and free goes from the sink back to the source.
+        // The end of the input is marked by null.
+        Control control;
+        std::vector<std::unique_ptr<CSVData>> batches;
+        auto& free = control.add_channel(queue_batches);
+        for (size_type i = 0; i < queue_batches; ++i) {
+            batches.push_back(std::make_unique<CSVData>());
+            CSVData* batch = batches.back().get();
+            free.queue.try_push(batch);
+        }
+        std::vector<Channel*> queues;
+        for (size_type i = 0; i <= stages.size(); ++i)
+            queues.push_back(&control.add_channel(queue_batches));
+
+        std::vector<std::thread> threads;
+
+        threads.push_back(start(control, [this, &control, &free, &queues]() {
+            while (true) {
+                auto batch = control.pop(free);
+                if (!source.read_batch(*batch, batch_rows)) {
+                    control.push(*queues.front(), nullptr);
+                    return;
+                }
+                control.push(*queues.front(), batch);
+            }
+        }));
+
+        for (size_type i = 0; i < stages.size(); ++i)
+            threads.push_back(start(control, [&stage = stages[i], &control, &input = *queues[i], &output = *queues[i + 1]]() {
+                while (true) {
+                    auto batch = control.pop(input);
+                    if (batch)
+                        stage(batch->get_values());
+                    control.push(output, batch);
+                    if (!batch)
+                        return;
+                }
+            }));
+
+        size_type number = 0;
+        try {
+            while (auto batch = control.pop(*queues.back())) {
+                auto& rows = batch->get_values();
+                number += rows.size();
+                if (!rows.empty())
+                    sink(rows);
+                control.push(free, batch);
+            }
+        }
+        catch (const Stopped&) {}
+        catch (...) {
+            control.fail(std::current_exception());
+        }
+
+        for (auto& i : threads)
+            i.join();
+        if (control.error)
+            std::rethrow_exception(control.error);
+        return number;
+    }
+};
+
+
+}
+
+
+#endif
@@ -5,7 +5,18 @@
 
 
 #include <fstream>
+#include <istream>
+#include <streambuf>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <cstdint>
+#include <cstring>
+#include <exception>
 #include <stdexcept>
+#include <system_error>
+#include <utility>
 
 #include "./csv_data.hpp"
 #include "./csv_parser.hpp"
@@ -17,6 +28,9 @@ namespace csvm {
 class CSVReader {
 // Reads a CSV file and extracts its data into the CSVData object.
 // It reads file only once, so you must create a new instance to read it again.
+//
+// .build_index() makes the reader write a sidecar index with the byte offset of every Kth row while the file is read.
+// With the index, .seek_row() parses only from the nearest indexed row before the wanted one.
 public:
 
     using vector_s = std::vector<std::string>;
@@ -28,11 +42,12 @@ public:
 
 
     class FileIterator {
-    // Reads and iterates the input file stream line by line.
+    // Reads and iterates the input stream line by line. Raises std::runtime_error if reading fails.
+    // The error is raised on the next comparison, so the line read before it is still parsed.
     // Doesn't close it at the end, so you should do it yourself after.
     public:
 
-        FileIterator(std::ifstream& input) : input{&input} {
+        FileIterator(std::istream& input) : input{&input} {
             // Creates a valid FileIterator object, that can be used to read lines.
             if (input)
                 ++*this;
@@ -48,34 +63,58 @@ public:
 
         FileIterator& operator++() {
             // Gets a new line and returns self.
-            getline(*input, line);
+            read_line();
             return *this;
         }
 
         FileIterator operator++(int) {
             // Gets a new line and returns a copy of self from before it.
             auto copy = *this;
-            getline(*input, line);
+            read_line();
             return copy;
         }
 
         bool operator==(FileIterator other) {
+            check();
             return static_cast<bool>(*input) == static_cast<bool>(other.input);
         }
 
         bool operator!=(FileIterator other) {
+            check();
             return static_cast<bool>(*input) != static_cast<bool>(other.input);
         }
 
         operator bool() {
+            check();
             return static_cast<bool>(*input);
         }
 
     private:
         // The pointer to the input stream.
-        std::ifstream* input = nullptr;
+        std::istream* input = nullptr;
         // Current line of the file.
         std::string line;
+        // The error of the last reading, if it failed.
+        std::exception_ptr error;
+
+        void read_line() {
+            // The stream buffer may fail, for example on broken compressed data, which sets the bad bit of the stream.
+            // The stream rethrows the error of the buffer if the bad bit is in its exceptions.
+            try {
+                getline(*input, line);
+                if (input->bad())
+                    throw std::runtime_error("Can't read the input stream.");
+            }
+            catch (...) {
+                error = std::current_exception();
+            }
+        }
+
+        void check() {
+            // Raises the error of the last reading.
+            if (error)
+                std::rethrow_exception(std::exchange(error, nullptr));
+        }
     };
 
 
@@ -103,11 +142,30 @@ public:
     }
 
 
+    CSVReader(CSVData& output, std::unique_ptr<std::streambuf> input, std::string sep = ",", char quote = '"', vector_s columns = {}) :
+        output{output}, sep{sep}, quote{quote}, columns{columns}, buffer{std::move(input)}
+        {
+        // Reads from the stream buffer instead of a file, for example from CSVGzipInput of "csv_gzip.hpp".
+        // Other arguments are the same as in the constructor from a path. Errors of the buffer are raised as they are.
+        file.exceptions(std::ios::badbit);
+        output.clear();
+        extract_header();
+    }
+
+
     CSVReader& read_all() {
         // Reads all the data from the file and inserts it into the output. Closes the file stream at the end.
-        if (file.is_open()) {
-            while (parser_iter != parser_iter_end)
+        // The output is marked as synchronized with the file.
+        // After the first reserve_sample rows, rows of the output are reserved for the rest of the file, estimated from their average size.
+        if (buffer) {
+            size_type begin = parser.parser.row_position, read = 0;
+            while (parser_iter != parser_iter_end) {
                 read_line();
+                if (++read == reserve_sample)
+                    reserve_rows(begin, read);
+            }
+            output.mark_synced();
+            finish_index();
             close();
         }
         else
@@ -119,18 +177,135 @@ public:
 
     CSVReader& read_line() {
         // Parses one raw CSV data line into a vector and adds it to the CSVData.
-        auto row = *parser_iter++;
+        // The parsed row is moved into the output, so its fields aren't copied.
+        index_row();
+        auto& row = *parser_iter;
+
+        row.resize(column_number);
+        output.add_row_unchecked(std::move(row));
+        ++parser_iter;
+
+        return *this;
+    }
+
+
+    size_type read_batch(CSVData& batch, size_type max_rows = 65536) {
+        /* Reads up to max_rows rows into the batch instead of the output and returns the number of read rows.
+         * The batch gets the columns of the output, and its previous rows are overwritten in place, so their storage is reused.
+         * Returns 0 if there is nothing left to read. Closes the file stream at the end.
+         *
+         * Reading a file batch by batch keeps memory bounded by the batch size:
+         *     while (reader.read_batch(batch)) writer.write_batch(batch);
+         */
+        if (!buffer) {
+            batch.get_values().clear();
+            return 0;
+        }
+
+        if (batch.get_column_index() != output.get_column_index())
+            batch.get_column_index() = output.get_column_index();
+
+        auto& rows = batch.get_values();
+        size_type number = 0;
+
+        for (; number < max_rows && parser_iter != parser_iter_end; ++number) {
+            index_row();
+
+            if (number == rows.size())
+                rows.emplace_back();
+            auto& row = rows[number];
+            row.resize(column_number);
+
+            // Fields are copied from the parsed row once, into the storage of the batch.
+            auto& parsed = *parser_iter;
+            for (size_type i = 0; i < column_number; ++i) {
+                if (i < parsed.size())
+                    row[i].assign(parsed[i]);
+                else
+                    row[i].clear();
+            }
+            ++parser_iter;
+        }
 
-        row.resize(column_number, "");
-        output.add_row(row);
+        rows.erase(rows.begin() + number, rows.end());
 
+        if (parser_iter == parser_iter_end) {
+            finish_index();
+            close();
+        }
+
+        return number;
+    }
+
+
+    CSVReader& build_index(size_type every = 4096, std::string index_path = "") {
+        /* Makes the reader record the byte offset of every row with a number divisible by every, and write them into the index file
+         * when .read_all() or .read_batch() reaches the end of the file. It costs one comparison per row.
+         * The default index path is the path of the file with ".idx". Must be called before any row is read.
+         * Raises std::invalid_argument if every is 0, and std::runtime_error if rows have been read or the reader doesn't read a file.
+         */
+        if (every == 0)
+            throw std::invalid_argument("The index step must be positive.");
+        if (path.empty())
+            throw std::runtime_error("Only a reader of a file can build an index.");
+        if (row_number != 0 || !from_start)
+            throw std::runtime_error("The index must be built from the first row.");
+
+        index_every = every;
+        this->index_path = index_path;
+        index_offsets.clear();
+        return *this;
+    }
+
+
+    CSVReader& seek_row(size_type number, std::string index_path = "") {
+        /* Moves the reader, so the next read row is the row with the number, counting from 0 after the header.
+         * If the index file is valid, parsing starts from the nearest indexed row, otherwise from the first row.
+         * The index is valid if it was built with the same separator, quote and header from a file of the same size and modification time.
+         * The default index path is the path of the file with ".idx".
+         * Raises std::out_of_range if there is no such row, and std::runtime_error if the file stream is closed or can't be moved.
+         */
+        if (!buffer)
+            throw std::runtime_error("The file stream is closed.");
+        if (path.empty())
+            throw std::runtime_error("Only a reader of a file can seek rows.");
+
+        size_type position = data_begin, skipped = number;
+        Index index;
+        if (load_index(index_path.empty() ? path + ".idx" : index_path, index)) {
+            if (number >= index.rows)
+                throw std::out_of_range("The file has only " + std::to_string(index.rows) + " rows.");
+            position = index.offsets[number / index.every];
+            skipped = number % index.every;
+        }
+        else if (position >= std::filesystem::file_size(path))
+            throw std::out_of_range("The file has no rows.");
+
+        file.clear();
+        if (!file.seekg(position))
+            throw std::runtime_error("Can't move in the file \"" + path + "\".");
+
+        file_iter = FileIterator(file);
+        parser.parser.reset(file_iter, position);
+        parser_iter = CSVParser<FileIterator>::Iterator(parser.parser);
+        for (; skipped && parser_iter != parser_iter_end; --skipped)
+            ++parser_iter;
+        if (skipped || parser_iter == parser_iter_end)
+            throw std::out_of_range("The file has fewer rows than " + std::to_string(number + 1) + ".");
+
+        // Rows aren't read from the first one any more, so the index can't be built.
+        index_every = 0;
+        from_start = false;
+        row_number = number;
         return *this;
     }
 
 
     CSVReader& close() {
         // Closes input file stream.
-        file.close();
+        file.exceptions(std::ios::goodbit);
+        file.rdbuf(nullptr);
+        buffer.reset();
         return *this;
     }
 
@@ -145,8 +320,9 @@ private:
     vector_s columns;
     vector_s::size_type column_number;
 
-    // input file stream object.
-    std::ifstream file{path};
+    // The buffer which reads the file, or null if it isn't open, and the input stream over it.
+    std::unique_ptr<std::streambuf> buffer = open_file(path);
+    std::istream file{buffer.get()};
 
     // input file stream iterator.
     FileIterator file_iter{file}, file_iter_end;
@@ -157,6 +333,37 @@ private:
     // Parser's iterators.
     CSVParser<FileIterator>::Iterator parser_iter = parser.begin(), parser_iter_end = parser.end();
 
+    // Number of rows after which .read_all() estimates the number of the rest rows. Reserved rows get an eighth more for shorter rows.
+    static constexpr size_type reserve_sample = 256;
+
+    // The byte offset of the first row after the header, the number of the next row, and was the reading started from the first row.
+    size_type data_begin = 0, row_number = 0;
+    bool from_start = true;
+
+    // The index which is built: every which row is recorded (0 if it isn't built), its file, and offsets of recorded rows.
+    size_type index_every = 0;
+    std::string index_path;
+    std::vector<std::uint64_t> index_offsets;
+
+
+    struct Index {
+    // The content of an index file.
+        size_type every, rows;
+        std::vector<std::uint64_t> offsets;
+    };
+
+    // Index files start with the magic string and the version.
+    static constexpr char index_magic[8] = {'C', 'S', 'V', 'M', 'I', 'D', 'X', 1};
+
+
+    static std::unique_ptr<std::streambuf> open_file(const std::string& path) {
+        // Opens the file for reading, or returns null if it can't be opened.
+        auto output = std::make_unique<std::filebuf>();
+        if (!output->open(path, std::ios::in | std::ios::binary))
+            return nullptr;
+        return output;
+    }
+
 
     void extract_header() {
         // Parses the CSV file header and adds its fields as output columns.
@@ -167,6 +374,88 @@ private:
             output.add_column(i);
 
         column_number = columns.size();
+        data_begin = parser.parser.row_position;
+    }
+
+
+    void reserve_rows(size_type begin, size_type read) {
+        // Reserves rows of the output for the rest of the file, from the average size of the rows read since the offset begin.
+        // Only the size of a file is known, so nothing is reserved when the reader reads a stream buffer.
+        std::error_code error;
+        size_type size = path.empty() ? 0 : std::filesystem::file_size(path, error);
+        size_type position = parser.parser.row_position;
+        if (error || position <= begin || size <= position)
+            return;
+
+        size_type average = std::max<size_type>((position - begin) / read, 1);
+        size_type rest = (size - position) / average;
+        output.reserve(output.row_number() + rest + rest / 8 + 1);
+    }
+
+
+    void index_row() {
+        // Records the offset of the row which is going to be read, if its number is divisible by the index step.
+        if (index_every && row_number % index_every == 0)
+            index_offsets.push_back(parser.parser.row_position);
+        ++row_number;
+    }
+
+
+    std::vector<std::uint64_t> index_key() {
+        // Values which must be the same in the index and the file: size, modification time, the separator, the quote and the first row offset.
+        std::vector<std::uint64_t> output = {std::filesystem::file_size(path),
+                                             static_cast<std::uint64_t>(std::filesystem::last_write_time(path).time_since_epoch().count()),
+                                             static_cast<unsigned char>(quote), data_begin, sep.size()};
+        for (unsigned char c : sep)
+            output.push_back(c);
+        return output;
+    }
+
+
+    void finish_index() {
+        // Writes the index file, if it's built. Raises std::runtime_error if it can't be written.
+        if (!index_every)
+            return;
+
+        std::string output_path = index_path.empty() ? path + ".idx" : index_path;
+        std::vector<std::uint64_t> numbers = index_key();
+        numbers.push_back(index_every);
+        numbers.push_back(row_number);
+        numbers.push_back(index_offsets.size());
+        numbers.insert(numbers.end(), index_offsets.begin(), index_offsets.end());
+        index_every = 0;
+
+        std::ofstream index(output_path, std::ios::binary | std::ios::trunc);
+        index.write(index_magic, sizeof(index_magic));
+        index.write(reinterpret_cast<const char*>(numbers.data()), numbers.size() * sizeof(std::uint64_t));
+        if (!index.flush())
+            throw std::runtime_error("Can't write the index \"" + output_path + "\".");
+    }
+
+
+    bool load_index(const std::string& index_path, Index& output) {
+        // Reads the index file. Returns false if it doesn't exist, is broken, or was built for another file or settings.
+        std::ifstream index(index_path, std::ios::binary);
+        if (!index)
+            return false;
+
+        auto key = index_key();
+        char magic[sizeof(index_magic)];
+        std::vector<std::uint64_t> numbers(key.size() + 3);
+        index.read(magic, sizeof(magic));
+        index.read(reinterpret_cast<char*>(numbers.data()), numbers.size() * sizeof(std::uint64_t));
+        if (!index || std::memcmp(magic, index_magic, sizeof(magic)) != 0 || !std::equal(key.begin(), key.end(), numbers.begin()))
+            return false;
+
+        output.every = numbers[key.size()];
+        output.rows = numbers[key.size() + 1];
+        auto count = numbers[key.size() + 2];
+        if (output.every == 0 || count != (output.rows + output.every - 1) / output.every)
+            return false;
+
+        output.offsets.resize(count);
+        index.read(reinterpret_cast<char*>(output.offsets.data()), count * sizeof(std::uint64_t));
+        return static_cast<bool>(index);
     }
 
 
@@ -0,0 +1,355 @@
+// Header with CSVScanner class, which finds structural characters of CSV text, CSVMappedFile class, and CSVCounter class.
+
+#ifndef CSV_MANAGER_CSV_SCANNER
+#define CSV_MANAGER_CSV_SCANNER
+
+
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+
+namespace csvm {
+
+
+class CSVScanner {
+/* Finds the first of a small set of characters in a range of bytes, for example quotes, line feeds and the first character
+ * of the delimiter. Bytes between them are skipped without looking at them one by one:
+ * 16 bytes are compared with every character at once if SSE2 is available, and a table is used for the rest.
+ */
+public:
+
+    using size_type = std::string::size_type;
+
+
+    CSVScanner(const std::string& characters) {
+        // Takes the set of at most 8 different characters. Repeated characters are ignored.
+        // Raises std::invalid_argument if there are more.
+        for (unsigned char c : characters) {
+            if (table[c])
+                continue;
+            if (number == 8)
+                throw std::invalid_argument("CSVScanner can't search for more than 8 characters.");
+            table[c] = true;
+#if defined(__SSE2__)
+            vectors[number] = _mm_set1_epi8(static_cast<char>(c));
+#endif
+            ++number;
+        }
+    }
+
+
+    bool contains(char c) const {
+        // Checks if the character is in the set.
+        return table[static_cast<unsigned char>(c)];
+    }
+
+
+    const char* find(const char* begin, const char* end) const {
+        // Returns the pointer to the first character from the set, or end if there is none.
+#if defined(__SSE2__)
+        for (; end - begin >= 16; begin += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+            __m128i found = _mm_setzero_si128();
+            for (size_type i = 0; i < number; ++i)
+                found = _mm_or_si128(found, _mm_cmpeq_epi8(block, vectors[i]));
+            if (int mask = _mm_movemask_epi8(found))
+                return begin + __builtin_ctz(mask);
+        }
+#endif
+        for (; begin != end; ++begin)
+            if (table[static_cast<unsigned char>(*begin)])
+                return begin;
+        return end;
+    }
+
+
+private:
+    bool table[256] = {};
+    size_type number = 0;
+
+#if defined(__SSE2__)
+    __m128i vectors[8];
+#endif
+};
+
+
+class CSVMappedFile {
+// Read-only memory mapping of a whole file. An empty file has no mapping and a null .data(). Works only on POSIX systems.
+public:
+
+    using size_type = std::string::size_type;
+
+
+    CSVMappedFile(const std::string& path) {
+        // Maps the file. Raises std::runtime_error if it can't be opened or mapped.
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Can't open the file \"" + path + "\".");
+
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Can't read the size of the file \"" + path + "\".");
+        }
+
+        file_size = info.st_size;
+        if (file_size) {
+            void* address = ::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("Can't map the file \"" + path + "\".");
+            }
+            ::madvise(address, file_size, MADV_SEQUENTIAL);
+            begin = static_cast<const char*>(address);
+        }
+        ::close(fd);
+    }
+
+    CSVMappedFile(const CSVMappedFile&) = delete;
+    CSVMappedFile& operator=(const CSVMappedFile&) = delete;
+
+    ~CSVMappedFile() {
+        if (begin)
+            ::munmap(const_cast<char*>(begin), file_size);
+    }
+
+
+    const char* data() const {
+        return begin;
+    }
+
+    size_type size() const {
+        return file_size;
+    }
+
+
+private:
+    const char* begin = nullptr;
+    size_type file_size = 0;
+};
+
+
+class CSVCounter {
+/* Counts rows of CSV text and collects statistics of rows without creating strings of fields.
+ *
+ * A quote begins a quoted part only at the start of a field, and line feeds inside quoted parts don't end rows,
+ * as in CSVLazyData. .count_rows() looks only at line feeds and quotes: outside quotes, line feeds are counted
+ * by 16 bytes at once with SSE2, and quoted parts are skipped with memchr. .scan_stats() also finds delimiters to count fields.
+ * Both count the header as a row, and the last row may have no line end. .count_data_rows() doesn't count the header,
+ * like row_number() of CSVData, CSVReader and CSVLazyData.
+ */
+public:
+
+    using size_type = std::string::size_type;
+
+
+    struct Stats {
+    // Statistics of rows. Sizes are in bytes without line ends.
+        size_type rows = 0;
+        size_type max_row_size = 0;
+        size_type total_row_size = 0;
+        size_type max_fields = 0;
+        // Number of rows which have line ends inside quotes.
+        size_type multiline_rows = 0;
+
+        double average_row_size() const {
+            return rows ? static_cast<double>(total_row_size) / rows : 0;
+        }
+    };
+
+
+    CSVCounter(std::string delimiter = ",", char quote = '"') : delimiter{delimiter}, quote{quote},
+              scanner{std::string("\n") + quote}, field_scanner{std::string("\n") + quote + delimiter.substr(0, 1)} {
+        // Raises std::invalid_argument if the delimiter is empty or contains the quote.
+        if (delimiter.empty() || delimiter.find(quote) != std::string::npos)
+            throw std::invalid_argument("The delimiter can't be empty or contain the quote.");
+    }
+
+
+    size_type count_rows(const char* data, size_type size) const {
+        // Returns the number of rows in the text.
+        const char* end = data + size;
+        const char* row = data;
+        size_type rows = 0;
+
+        for (const char* i = data; (i = skip_unquoted(i, end, rows, row)) != end; ++i) {
+            if (at_field_start(row, i)) {
+                i = closing_quote(i + 1, end);
+                if (i == end)
+                    break;
+            }
+        }
+        return rows + (row != end);
+    }
+
+    size_type count_rows(const std::string& path) const {
+        // Maps the file and returns the number of rows in it. Raises std::runtime_error if it can't be mapped.
+        CSVMappedFile file(path);
+        return count_rows(file.data(), file.size());
+    }
+
+
+    size_type count_data_rows(const char* data, size_type size) const {
+        // Returns the number of rows after the header in the text.
+        auto rows = count_rows(data, size);
+        return rows ? rows - 1 : 0;
+    }
+
+    size_type count_data_rows(const std::string& path) const {
+        // Maps the file and returns the number of rows after the header in it. Raises std::runtime_error if it can't be mapped.
+        CSVMappedFile file(path);
+        return count_data_rows(file.data(), file.size());
+    }
+
+
+    Stats scan_stats(const char* data, size_type size) const {
+        // Returns statistics of rows of the text.
+        Stats output;
+        const char* end = data + size;
+        for (const char* row = data; row != end;) {
+            size_type fields = 1;
+            bool multiline = false;
+            const char* i = row;
+
+            while ((i = field_scanner.find(i, end)) != end && *i != '\n') {
+                if (*i == quote) {
+                    if (!at_field_start(row, i)) {
+                        ++i;
+                        continue;
+                    }
+                    auto closing = closing_quote(i + 1, end);
+                    multiline |= std::memchr(i, '\n', closing - i) != nullptr;
+                    i = closing == end ? end : closing + 1;
+                    if (i == end)
+                        break;
+                }
+                else if (matches(i, end)) {
+                    ++fields;
+                    i += delimiter.size();
+                }
+                else
+                    ++i;
+            }
+
+            const char* next = i == end ? end : i + 1;
+            if (i != end && i != row && i[-1] == '\r')
+                --i;
+            size_type row_size = i - row;
+
+            ++output.rows;
+            output.total_row_size += row_size;
+            output.max_row_size = std::max(output.max_row_size, row_size);
+            output.max_fields = std::max(output.max_fields, fields);
+            output.multiline_rows += multiline;
+            row = next;
+        }
+        return output;
+    }
+
+    Stats scan_stats(const std::string& path) const {
+        // Maps the file and returns statistics of its rows. Raises std::runtime_error if it can't be mapped.
+        CSVMappedFile file(path);
+        return scan_stats(file.data(), file.size());
+    }
+
+
+    const char* row_end(const char* begin, const char* end) const {
+        // Returns the position after the line feed which ends the row which starts at begin, or end.
+        const char* i = begin;
+        while ((i = scanner.find(i, end)) != end) {
+            if (*i == '\n')
+                return i + 1;
+            if (at_field_start(begin, i)) {
+                i = closing_quote(i + 1, end);
+                if (i == end)
+                    return end;
+            }
+            ++i;
+        }
+        return end;
+    }
+
+
+private:
+    std::string delimiter;
+    char quote;
+
+    // Finds line feeds and quotes, and also the first character of the delimiter.
+    CSVScanner scanner, field_scanner;
+
+
+    bool matches(const char* position, const char* end) const {
+        // Checks if the delimiter starts at the position.
+        return static_cast<size_type>(end - position) >= delimiter.size() &&
+               std::memcmp(position, delimiter.data(), delimiter.size()) == 0;
+    }
+
+
+    bool at_field_start(const char* row, const char* position) const {
+        // Checks if the position is the start of a field: the start of the row or right after the delimiter.
+        return position == row || (static_cast<size_type>(position - row) >= delimiter.size() &&
+                                   std::memcmp(position - delimiter.size(), delimiter.data(), delimiter.size()) == 0);
+    }
+
+
+    const char* closing_quote(const char* begin, const char* end) const {
+        // Returns the position of the quote which closes a quoted part, skipping doubled quotes, or end.
+        while ((begin = static_cast<const char*>(std::memchr(begin, quote, end - begin)))) {
+            if (begin + 1 != end && begin[1] == quote) {
+                begin += 2;
+                continue;
+            }
+            return begin;
+        }
+        return end;
+    }
+
+
+    const char* skip_unquoted(const char* i, const char* end, size_type& rows, const char*& row) const {
+        // Returns the position of the next quote, or end. Counts line feeds before it and moves row to the start of the last row.
+#if defined(__SSE2__)
+        const __m128i line_feeds = _mm_set1_epi8('\n'), quotes = _mm_set1_epi8(quote);
+        for (; end - i >= 16; i += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(i));
+            unsigned feeds = _mm_movemask_epi8(_mm_cmpeq_epi8(block, line_feeds));
+            unsigned found = _mm_movemask_epi8(_mm_cmpeq_epi8(block, quotes));
+            if (found)
+                // Only line feeds before the quote.
+                feeds &= (found & -found) - 1;
+            if (feeds) {
+                rows += __builtin_popcount(feeds);
+                row = i + (32 - __builtin_clz(feeds));
+            }
+            if (found)
+                return i + __builtin_ctz(found);
+        }
+#endif
+        for (; i != end; ++i) {
+            if (*i == quote)
+                return i;
+            if (*i == '\n') {
+                ++rows;
+                row = i + 1;
+            }
+        }
+        return end;
+    }
+};
+
+
+
+}
+
+
+#endif
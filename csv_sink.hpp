@@ -0,0 +1,418 @@
+// Header with sinks, into which encoded CSV is written.
+
+#ifndef CSV_MANAGER_CSV_SINK
+#define CSV_MANAGER_CSV_SINK
+
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+#include <unistd.h>
+#include <sys/uio.h>
+
+
+namespace csvm {
+
+
+/* Sinks take bytes through .write(data, size). CSVEncoder::encode_all() and Encoder::encode_to() write encoded rows
+ * straight into a sink, without creating a string for every row.
+ */
+
+
+class CSVBufferSink {
+// Appends everything into the growing buffer.
+public:
+
+    using size_type = std::string::size_type;
+
+    // The written bytes.
+    std::string buffer;
+
+
+    CSVBufferSink(size_type capacity = 0) {
+        buffer.reserve(capacity);
+    }
+
+    void write(const char* data, size_type size) {
+        buffer.append(data, size);
+    }
+
+    CSVBufferSink& clear() {
+        // Deletes written bytes, keeping the capacity.
+        buffer.clear();
+        return *this;
+    }
+};
+
+
+class CSVCallbackSink {
+// Collects bytes in the fixed buffer, and passes them to the callback when the buffer is full, or on .flush().
+// Pieces bigger than the buffer are passed to the callback directly. The destructor doesn't flush.
+public:
+
+    using size_type = std::string::size_type;
+    using callback_type = std::function<void(const char*, size_type)>;
+
+
+    CSVCallbackSink(char* buffer, size_type capacity, callback_type callback) : begin{buffer}, capacity{capacity},
+                   callback{std::move(callback)} {}
+
+
+    void write(const char* data, size_type size) {
+        if (size > capacity - used) {
+            flush();
+            if (size >= capacity) {
+                callback(data, size);
+                return;
+            }
+        }
+        std::memcpy(begin + used, data, size);
+        used += size;
+    }
+
+    CSVCallbackSink& flush() {
+        // Passes buffered bytes to the callback.
+        if (used) {
+            callback(begin, used);
+            used = 0;
+        }
+        return *this;
+    }
+
+
+private:
+    // The buffer, its capacity and the number of used bytes.
+    char* begin;
+    size_type capacity;
+    size_type used = 0;
+
+    callback_type callback;
+};
+
+
+class CSVMemorySink {
+// Writes bytes into the fixed memory range, for example a part of a mapped file. Raises std::length_error if the range is overflowed.
+public:
+
+    using size_type = std::string::size_type;
+
+
+    CSVMemorySink(char* begin, size_type capacity) : begin{begin}, capacity{capacity} {}
+
+
+    void write(const char* data, size_type size) {
+        if (size > capacity - used)
+            throw std::length_error("The memory range is overflowed.");
+        std::memcpy(begin + used, data, size);
+        used += size;
+    }
+
+    size_type size() const {
+        // Returns the number of written bytes.
+        return used;
+    }
+
+
+private:
+    char* begin;
+    size_type capacity;
+    size_type used = 0;
+};
+
+
+class CSVFileSink {
+/* Collects bytes in a big buffer and writes them into the file descriptor with write(), or with one writev()
+ * of the buffer and a piece which doesn't fit into it. Counts written bytes and system calls.
+ *
+ * fsync() is called by the sync policy: never, on .close(), or every time sync_bytes more bytes are written
+ * (and on .close()). Flushes on destruction, but doesn't sync or close the descriptor.
+ * Raises std::runtime_error if writing or syncing fails.
+ */
+public:
+
+    using size_type = std::string::size_type;
+
+
+    // Member classes.
+
+
+    enum class Sync {never, on_close, periodic};
+
+
+    struct Stats {
+    // Bytes written into the file, and numbers of write()/writev() and fsync() calls.
+        size_type bytes = 0;
+        size_type syscalls = 0;
+        size_type syncs = 0;
+    };
+
+
+    // Methods.
+
+
+    CSVFileSink(int fd, size_type capacity = 1 << 16, Sync sync = Sync::never, size_type sync_bytes = 64 << 20) : fd{fd},
+               buffer(std::max<size_type>(capacity, 1)), sync_policy{sync}, sync_bytes{std::max<size_type>(sync_bytes, 1)} {}
+
+    CSVFileSink(const CSVFileSink&) = delete;
+    CSVFileSink& operator=(const CSVFileSink&) = delete;
+
+    ~CSVFileSink() {
+        try {
+            flush();
+        }
+        catch (...) {}
+    }
+
+
+    void write(const char* data, size_type size) {
+        if (size > buffer.size() - used) {
+            if (size >= buffer.size()) {
+                // Buffered bytes and the piece go into the file together.
+                iovec pieces[2] = {{buffer.data(), used}, {const_cast<char*>(data), size}};
+                used = 0;
+                write_all(pieces, 2);
+                return;
+            }
+            flush();
+        }
+        std::memcpy(buffer.data() + used, data, size);
+        used += size;
+    }
+
+    CSVFileSink& flush() {
+        // Writes buffered bytes into the file descriptor.
+        if (used) {
+            iovec piece{buffer.data(), used};
+            used = 0;
+            write_all(&piece, 1);
+        }
+        return *this;
+    }
+
+    CSVFileSink& sync() {
+        // Flushes and calls fsync() regardless of the policy.
+        flush();
+        if (::fsync(fd) != 0)
+            throw std::runtime_error("Can't sync the file: " + std::string(std::strerror(errno)) + ".");
+        ++statistics.syncs;
+        unsynced = 0;
+        return *this;
+    }
+
+    CSVFileSink& close() {
+        // Flushes, and syncs unless the policy is never. The descriptor stays open.
+        flush();
+        if (sync_policy != Sync::never && unsynced)
+            sync();
+        return *this;
+    }
+
+
+    const Stats& stats() const {
+        return statistics;
+    }
+
+
+private:
+    int fd;
+    std::vector<char> buffer;
+    size_type used = 0;
+
+    Sync sync_policy;
+    size_type sync_bytes, unsynced = 0;
+    Stats statistics;
+
+
+    void write_all(iovec* pieces, int count) {
+        // Calls writev() until all pieces are written, then syncs if the periodic policy requires it.
+        while (count) {
+            auto written = ::writev(fd, pieces, count);
+            if (written < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw std::runtime_error("Can't write into the file: " + std::string(std::strerror(errno)) + ".");
+            }
+            ++statistics.syscalls;
+            statistics.bytes += written;
+            unsynced += written;
+
+            size_type left = written;
+            while (count && left >= pieces->iov_len) {
+                left -= pieces->iov_len;
+                ++pieces;
+                --count;
+            }
+            if (count) {
+                pieces->iov_base = static_cast<char*>(pieces->iov_base) + left;
+                pieces->iov_len -= left;
+            }
+        }
+
+        if (sync_policy == Sync::periodic && unsynced >= sync_bytes)
+            sync();
+    }
+};
+
+
+template <typename Target> class CSVAsyncSink {
+/* Collects bytes in one of a fixed number of buffers, while a background thread writes filled buffers into the target sink.
+ * When all buffers are filled and not written yet, .write() waits, so memory is bounded by buffers * capacity.
+ *
+ * The target is a sink with .flush(), used only by the background thread until .wait() returns.
+ * The background thread flushes it whenever it has no more buffers to write.
+ * Exceptions thrown by the target are rethrown by .write() and .wait(), and all bytes after the exception are dropped. The destructor waits for all buffers, ignoring errors.
+ */
+public:
+
+    using size_type = std::string::size_type;
+
+
+    CSVAsyncSink(Target& target, size_type capacity = 1 << 22, size_type buffers = 2) : target{target},
+                capacity{std::max<size_type>(capacity, 1)}, storage(std::max<size_type>(buffers, 2)) {
+        for (size_type i = 0; i < storage.size(); ++i) {
+            storage[i].reserve(this->capacity);
+            free.push_back(i);
+        }
+        worker = std::thread(&CSVAsyncSink::work, this);
+    }
+
+    CSVAsyncSink(const CSVAsyncSink&) = delete;
+    CSVAsyncSink& operator=(const CSVAsyncSink&) = delete;
+
+    ~CSVAsyncSink() {
+        try {
+            wait();
+        }
+        catch (...) {}
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopped = true;
+        }
+        work_ready.notify_one();
+        worker.join();
+    }
+
+
+    void write(const char* data, size_type size) {
+        while (size) {
+            if (current == none)
+                acquire();
+            auto& buffer = storage[current];
+            auto piece = std::min(size, capacity - buffer.size());
+            buffer.append(data, piece);
+            data += piece;
+            size -= piece;
+            if (buffer.size() == capacity)
+                submit();
+        }
+    }
+
+    CSVAsyncSink& flush() {
+        // Passes the current buffer to the background thread without waiting.
+        if (current != none && !storage[current].empty())
+            submit();
+        return *this;
+    }
+
+    CSVAsyncSink& wait() {
+        // Flushes and waits until all buffers are written into the target and the target is flushed.
+        flush();
+        std::unique_lock<std::mutex> lock(mutex);
+        space_ready.wait(lock, [this]() {return filled.empty() && !busy;});
+        if (error)
+            std::rethrow_exception(error);
+        return *this;
+    }
+
+
+private:
+    Target& target;
+    size_type capacity;
+
+    // Buffers, indexes of free and filled ones, and the index of the buffer which is being filled.
+    static constexpr size_type none = static_cast<size_type>(-1);
+    std::vector<std::string> storage;
+    std::deque<size_type> free, filled;
+    size_type current = none;
+
+    // The background thread and its synchronization.
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable work_ready, space_ready;
+    bool busy = false, stopped = false;
+    std::exception_ptr error;
+
+
+    void acquire() {
+        // Takes a free buffer, waiting for the background thread if there is none.
+        std::unique_lock<std::mutex> lock(mutex);
+        space_ready.wait(lock, [this]() {return !free.empty() || error;});
+        if (error)
+            std::rethrow_exception(error);
+        current = free.front();
+        free.pop_front();
+    }
+
+    void submit() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            filled.push_back(current);
+        }
+        current = none;
+        work_ready.notify_one();
+    }
+
+
+    void work() {
+        // Writes filled buffers until the sink is stopped. After an error, buffers are only returned to the free ones.
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            work_ready.wait(lock, [this]() {return stopped || !filled.empty();});
+            if (filled.empty())
+                return;
+
+            auto index = filled.front();
+            filled.pop_front();
+            busy = true;
+            bool failed = static_cast<bool>(error);
+            bool last = filled.empty();
+            lock.unlock();
+
+            std::exception_ptr exception;
+            if (!failed) {
+                try {
+                    target.write(storage[index].data(), storage[index].size());
+                    if (last)
+                        target.flush();
+                }
+                catch (...) {
+                    exception = std::current_exception();
+                }
+            }
+            storage[index].clear();
+
+            lock.lock();
+            if (exception)
+                error = exception;
+            free.push_back(index);
+            busy = false;
+            space_ready.notify_all();
+        }
+    }
+};
+
+
+}
+
+
+#endif
@@ -0,0 +1,377 @@
+// Header with CSVSnapshot class.
+
+#ifndef CSV_MANAGER_CSV_SNAPSHOT
+#define CSV_MANAGER_CSV_SNAPSHOT
+
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "./csv_data.hpp"
+
+
+namespace csvm {
+
+
+class CSVSnapshot {
+/* Read-only view of a binary snapshot of CSV data. The snapshot file is mapped into memory, so opening it costs
+ * only a validation of the header, and fields are read lazily as std::string_view on access.
+ *
+ * Snapshot layout (all numbers are 64-bit in the host byte order, which is recorded in the header):
+ *     header: magic "CSVMSNAP", 32-bit version, 32-bit byte order mark, number of columns, number of rows,
+ *             size of column names, size of field data, checksum of everything after the header, reserved.
+ *     column name offsets: column number + 1 offsets into column name bytes.
+ *     column name bytes: padded with zeros to a multiple of 8.
+ *     field offsets: row number * column number + 1 offsets into field bytes, fields go row after row.
+ *     field bytes.
+ *
+ * The checksum is FNV-1a over 64-bit words of the body. Verifying it reads the whole file, so it's checked on construction
+ * only if verify is true, or later by .is_checksum_valid(). Without it, the layout and every accessed offset are still checked.
+ * All methods throw std::runtime_error if the snapshot is broken.
+ *
+ * save_binary() and load_binary() write CSVData into a snapshot and load it back.
+ */
+public:
+
+    // Type aliases.
+    using vector_s = std::vector<std::string>;
+    using vector_v_s = std::vector<vector_s>;
+    using size_type = std::uint64_t;
+
+
+    // Format constants.
+    static constexpr char magic[8] = {'C', 'S', 'V', 'M', 'S', 'N', 'A', 'P'};
+    static constexpr std::uint32_t version = 1;
+    static constexpr std::uint32_t byte_order = 0x01020304;
+
+
+    // Member classes.
+
+
+    struct Header {
+    // The fixed-size snapshot header.
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t byte_order;
+        size_type column_number;
+        size_type row_number;
+        size_type names_size;
+        size_type data_size;
+        size_type checksum;
+        size_type reserved;
+    };
+
+
+    class Checksum {
+    // Incremental FNV-1a over 64-bit words. A trailing incomplete word is padded with zeros.
+    public:
+
+        Checksum& update(const char* data, std::size_t size) {
+            // Adds bytes to the checksum.
+            while (size && pending_size) {
+                pending[pending_size++] = *data++;
+                --size;
+                if (pending_size == 8)
+                    take_pending();
+            }
+
+            for (; size >= 8; data += 8, size -= 8) {
+                std::uint64_t word;
+                std::memcpy(&word, data, 8);
+                mix(word);
+            }
+
+            while (size--)
+                pending[pending_size++] = *data++;
+
+            return *this;
+        }
+
+        size_type digest() const {
+            // Returns the checksum of all added bytes.
+            auto copy = *this;
+            if (copy.pending_size) {
+                std::memset(copy.pending + copy.pending_size, 0, 8 - copy.pending_size);
+                copy.take_pending();
+            }
+            return copy.hash;
+        }
+
+    private:
+        std::uint64_t hash = 14695981039346656037ull;
+        char pending[8];
+        std::size_t pending_size = 0;
+
+        void mix(std::uint64_t word) {
+            hash = (hash ^ word) * 1099511628211ull;
+        }
+
+        void take_pending() {
+            std::uint64_t word;
+            std::memcpy(&word, pending, 8);
+            mix(word);
+            pending_size = 0;
+        }
+    };
+
+
+    // Attributes and methods.
+
+
+    CSVSnapshot(const std::string& path, bool verify = false) : path{path} {
+        // Maps the snapshot file and validates it. If verify is true, also checks the checksum of the whole file.
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Can't open the snapshot \"" + path + "\".");
+
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || static_cast<size_type>(info.st_size) < sizeof(Header)) {
+            ::close(fd);
+            broken("the file is too small");
+        }
+
+        file_size = info.st_size;
+        void* address = ::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (address == MAP_FAILED)
+            throw std::runtime_error("Can't map the snapshot \"" + path + "\".");
+        begin = static_cast<const char*>(address);
+
+        try {
+            validate_layout();
+            if (verify && !is_checksum_valid())
+                broken("the checksum doesn't match");
+        }
+        catch (...) {
+            ::munmap(const_cast<char*>(begin), file_size);
+            throw;
+        }
+    }
+
+    CSVSnapshot(const CSVSnapshot&) = delete;
+    CSVSnapshot& operator=(const CSVSnapshot&) = delete;
+
+    ~CSVSnapshot() {
+        ::munmap(const_cast<char*>(begin), file_size);
+    }
+
+
+    size_type column_number() const {
+        return header.column_number;
+    }
+    size_type row_number() const {
+        return header.row_number;
+    }
+
+
+    std::string_view column_name(size_type index) const {
+        // Returns the name of the column on a given index.
+        if (index >= header.column_number)
+            throw std::invalid_argument("There is no column with index \"" + std::to_string(index) + "\".");
+        return slice(name_offsets, names, header.names_size, index);
+    }
+
+    vector_s get_column_names() const {
+        // Returns vector with column names in their order.
+        vector_s output;
+        for (size_type i = 0; i < header.column_number; ++i)
+            output.emplace_back(column_name(i));
+        return output;
+    }
+
+
+    std::string_view field(size_type row, size_type column) const {
+        // Returns a view of one field. The view lives as long as the snapshot.
+        if (row >= header.row_number)
+            throw std::invalid_argument("There is no row with index \"" + std::to_string(row) + "\".");
+        if (column >= header.column_number)
+            throw std::invalid_argument("There is no column with index \"" + std::to_string(column) + "\".");
+        return slice(field_offsets, fields, header.data_size, row * header.column_number + column);
+    }
+
+    vector_s operator[](size_type row) const {
+        // Returns a copy of one row.
+        vector_s output;
+        output.reserve(header.column_number);
+        for (size_type i = 0; i < header.column_number; ++i)
+            output.emplace_back(field(row, i));
+        return output;
+    }
+
+
+    bool is_checksum_valid() const {
+        // Computes the checksum of the body and compares it with the one from the header.
+        return Checksum().update(begin + sizeof(Header), file_size - sizeof(Header)).digest() == header.checksum;
+    }
+
+
+    static void write(const std::string& path, const vector_s& column_names, const vector_v_s& values) {
+        // Writes a snapshot of the given columns and rows. Every row must have the same number of fields as there are columns.
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file)
+            throw std::runtime_error("Can't open the snapshot \"" + path + "\" for writing.");
+
+        Header head{};
+        std::memcpy(head.magic, magic, sizeof(magic));
+        head.version = version;
+        head.byte_order = byte_order;
+        head.column_number = column_names.size();
+        // Rows without columns have nothing to store, and readers reject such headers, because nothing bounds their number.
+        head.row_number = column_names.empty() ? 0 : values.size();
+        for (auto& i : column_names)
+            head.names_size += i.size();
+        for (auto& row : values)
+            for (auto& i : row)
+                head.data_size += i.size();
+
+        // The header is written twice: now as a placeholder and at the end with the checksum.
+        file.write(reinterpret_cast<const char*>(&head), sizeof(head));
+
+        Checksum checksum;
+        auto put = [&file, &checksum](const char* data, std::size_t size) {
+            file.write(data, size);
+            checksum.update(data, size);
+        };
+        auto put_offset = [&put](size_type offset) {
+            put(reinterpret_cast<const char*>(&offset), sizeof(offset));
+        };
+
+        size_type offset = 0;
+        put_offset(offset);
+        for (auto& i : column_names)
+            put_offset(offset += i.size());
+
+        for (auto& i : column_names)
+            put(i.data(), i.size());
+        const char padding[8] = {};
+        put(padding, padded(head.names_size) - head.names_size);
+
+        offset = 0;
+        put_offset(offset);
+        for (auto& row : values)
+            for (auto& i : row)
+                put_offset(offset += i.size());
+
+        for (auto& row : values)
+            for (auto& i : row)
+                put(i.data(), i.size());
+
+        head.checksum = checksum.digest();
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(&head), sizeof(head));
+
+        if (!file)
+            throw std::runtime_error("Can't write the snapshot \"" + path + "\".");
+    }
+
+
+private:
+    // Path to the file, the mapped memory and its size.
+    std::string path;
+    const char* begin = nullptr;
+    size_type file_size = 0;
+
+    // The header and pointers to the sections of the snapshot.
+    Header header;
+    const char* name_offsets = nullptr;
+    const char* names = nullptr;
+    const char* field_offsets = nullptr;
+    const char* fields = nullptr;
+
+
+    static size_type padded(size_type size) {
+        // Rounds the size up to a multiple of 8.
+        return (size + 7) / 8 * 8;
+    }
+
+
+    [[noreturn]] void broken(const std::string& reason) const {
+        throw std::runtime_error("The snapshot \"" + path + "\" is broken: " + reason + ".");
+    }
+
+
+    void validate_layout() {
+        // Checks the header and that the file size matches the sizes of all sections.
+        std::memcpy(&header, begin, sizeof(header));
+
+        if (std::memcmp(header.magic, magic, sizeof(magic)) != 0)
+            broken("it isn't a snapshot");
+        if (header.version != version)
+            broken("unsupported version \"" + std::to_string(header.version) + "\"");
+        if (header.byte_order != byte_order)
+            broken("it was written with a different byte order");
+
+        const size_type limit = file_size / sizeof(size_type);
+        if (header.column_number >= limit || header.names_size > file_size || header.data_size > file_size ||
+            (header.column_number ? header.row_number > limit / header.column_number : header.row_number != 0))
+            broken("the sizes in the header are invalid");
+
+        const size_type field_number = header.row_number * header.column_number;
+        const size_type expected = sizeof(Header) + (header.column_number + 1) * sizeof(size_type) + padded(header.names_size) +
+                                   (field_number + 1) * sizeof(size_type) + header.data_size;
+        if (expected != file_size)
+            broken("the file size doesn't match the header");
+
+        name_offsets = begin + sizeof(Header);
+        names = name_offsets + (header.column_number + 1) * sizeof(size_type);
+        field_offsets = names + padded(header.names_size);
+        fields = field_offsets + (field_number + 1) * sizeof(size_type);
+    }
+
+
+    std::string_view slice(const char* offsets, const char* bytes, size_type bytes_size, size_type index) const {
+        // Returns bytes between two neighbouring offsets.
+        size_type from, to;
+        std::memcpy(&from, offsets + index * sizeof(size_type), sizeof(size_type));
+        std::memcpy(&to, offsets + (index + 1) * sizeof(size_type), sizeof(size_type));
+
+        if (from > to || to > bytes_size)
+            broken("an offset is out of bounds");
+
+        return std::string_view(bytes + from, to - from);
+    }
+};
+
+
+inline void save_binary(CSVData& data, const std::string& path) {
+    // Writes columns and values of the data into the binary snapshot file, which can be loaded back by load_binary() or viewed with CSVSnapshot.
+    CSVSnapshot::write(path, data.get_column_names(), data.get_values());
+}
+
+
+inline CSVData& load_binary(CSVData& data, const std::string& path, bool verify = false) {
+    // Replaces all columns and values of the data with the content of the binary snapshot file.
+    // Raises std::runtime_error if the snapshot is broken. If verify is true, the checksum of the whole snapshot is also checked.
+    CSVSnapshot snapshot(path, verify);
+
+    data.clear();
+    for (auto& i : snapshot.get_column_names())
+        data.add_column(i);
+
+    auto& values = data.get_values();
+    values.resize(snapshot.row_number());
+    for (CSVSnapshot::size_type row = 0; row < values.size(); ++row) {
+        auto& target = values[row];
+        target.reserve(snapshot.column_number());
+        for (CSVSnapshot::size_type column = 0; column < snapshot.column_number(); ++column)
+            target.emplace_back(snapshot.field(row, column));
+    }
+
+    return data;
+}
+
+
+}
+
+
+#endif
@@ -0,0 +1,214 @@
+// Header with CSVSorter class.
+
+#ifndef CSV_MANAGER_CSV_SORT
+#define CSV_MANAGER_CSV_SORT
+
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <cstdint>
+#include <stdexcept>
+
+#include <unistd.h>
+
+#include "./csv_data.hpp"
+#include "./csv_reader.hpp"
+#include "./csv_writer.hpp"
+#include "./csv_merge.hpp"
+#include "./csv_thread_pool.hpp"
+
+
+namespace csvm {
+
+
+class CSVSorter {
+/* Sorts a CSV file of any size by values of key columns, using memory bounded by the memory budget.
+ *
+ * The input is read by batches into a run until the run reaches the memory budget. The run is sorted in parallel
+ * and spilled into a temporary file. Then all runs are merged into the output file by CSVMerger.
+ * If the whole input fits into one run, it's written into the output directly.
+ *
+ * Rows are compared by their key fields as strings, one key after another. The sort is stable.
+ * The header of the input is written into the output. Temporary files are deleted at the end.
+ */
+public:
+
+    // Type aliases.
+    using vector_s = std::vector<std::string>;
+    using vector_v_s = std::vector<vector_s>;
+    using size_type = vector_v_s::size_type;
+
+
+    CSVSorter(std::string input_path, std::string output_path, vector_s key_columns, std::string sep = ",", char quote = '"',
+              size_type memory_budget = 256 << 20, std::string temp_directory = "", unsigned threads = 0) :
+              input_path{input_path}, output_path{output_path}, key_columns{key_columns}, sep{sep}, quote{quote},
+              memory_budget{std::max<size_type>(memory_budget, 1)}, temp_directory{temp_directory}, pool{threads} {
+        /* CSVSorter constructor.
+         * Arguments:
+         *     input_path: Path to the CSV file which will be sorted.
+         *     output_path: Path to the file in which sorted rows will be written. Must differ from the input path.
+         *     key_columns: Names of columns by which rows are sorted, from the most significant.
+         *     sep: The separator used in the input and the output.
+         *     quote: The quote character.
+         *     memory_budget: Approximate number of bytes which rows of one run may take.
+         *     temp_directory: Directory for temporary files. If empty, the system temporary directory is used.
+         *     threads: Number of threads which sort runs. If 0, the number of hardware threads is used.
+         */
+        if (this->temp_directory.empty())
+            this->temp_directory = std::filesystem::temp_directory_path().string();
+    }
+
+
+    CSVSorter& sort() {
+        // Sorts the input file into the output file. Raises std::runtime_error if files can't be opened,
+        // and std::invalid_argument if there is no such key column.
+        if (!std::ifstream(input_path))
+            throw std::runtime_error("Can't open the file \"" + input_path + "\".");
+
+        CSVData header, batch, run;
+        CSVReader reader(header, input_path, sep, quote);
+        auto keys = key_indexes(header);
+        run.get_column_index() = header.get_column_index();
+
+        TemporaryFiles runs;
+        auto& rows = run.get_values();
+        size_type run_size = 0, total_rows = 0, total_size = 0;
+
+        while (reader.read_batch(batch, batch_rows)) {
+            for (auto& i : batch.get_values()) {
+                auto size = row_size(i);
+                run_size += size;
+                total_size += size;
+                rows.push_back(std::move(i));
+            }
+            total_rows += batch.row_number();
+
+            if (run_size >= memory_budget) {
+                sort_run(rows, keys);
+                runs.paths.push_back(temporary_path(runs.paths.size()));
+                CSVWriter(run, runs.paths.back(), sep, quote).write_all();
+                rows.clear();
+                run_size = 0;
+            }
+        }
+
+        sort_run(rows, keys);
+
+        if (runs.paths.empty()) {
+            CSVWriter(run, output_path, sep, quote).write_all();
+            return *this;
+        }
+
+        if (!rows.empty()) {
+            runs.paths.push_back(temporary_path(runs.paths.size()));
+            CSVWriter(run, runs.paths.back(), sep, quote).write_all();
+        }
+        rows = {};
+
+        merge_runs(runs.paths, total_size / total_rows);
+
+        return *this;
+    }
+
+
+private:
+    // Files, keys and settings.
+    std::string input_path, output_path;
+    vector_s key_columns;
+    std::string sep;
+    char quote;
+    size_type memory_budget;
+    std::string temp_directory;
+
+    // Workers which sort runs.
+    CSVThreadPool pool;
+
+    // Number of rows read and written at once.
+    static constexpr size_type batch_rows = 1024;
+
+
+    class TemporaryFiles {
+    // Deletes files when goes out of scope.
+    public:
+        vector_s paths;
+
+        ~TemporaryFiles() {
+            std::error_code error;
+            for (auto& i : paths)
+                std::filesystem::remove(i, error);
+        }
+    };
+
+
+    std::vector<size_type> key_indexes(CSVData& header) {
+        // Finds indexes of key columns.
+        std::vector<size_type> output;
+        auto& index = header.get_column_index();
+        for (auto& i : key_columns) {
+            auto found = index.find(i);
+            if (found == index.end())
+                throw std::invalid_argument("A column with name \"" + i + "\" doesn't exists.");
+            output.push_back(found->second);
+        }
+        return output;
+    }
+
+
+    static size_type row_size(const vector_s& row) {
+        // Approximate memory used by a row.
+        size_type output = sizeof(vector_s) + row.capacity() * sizeof(std::string);
+        for (auto& i : row)
+            if (i.size() >= sizeof(std::string))
+                output += i.capacity() + 1;
+        return output;
+    }
+
+
+    std::string temporary_path(size_type number) const {
+        // Returns a path for the temporary file of a run, unique for this sorter.
+        return (std::filesystem::path(temp_directory) / ("csvm_sort_" + std::to_string(reinterpret_cast<std::uintptr_t>(this)) +
+                "_" + std::to_string(::getpid()) + "_" + std::to_string(number) + ".csv")).string();
+    }
+
+
+    void sort_run(vector_v_s& rows, const std::vector<size_type>& keys) {
+        // Sorts chunks of rows on workers, then merges neighbouring chunks in parallel until one is left.
+        auto less = [&keys](const vector_s& left, const vector_s& right) {
+            for (auto k : keys) {
+                auto order = left[k].compare(right[k]);
+                if (order != 0)
+                    return order < 0;
+            }
+            return false;
+        };
+
+        size_type chunks = std::min<size_type>(pool.size(), rows.size() / batch_rows + 1);
+        auto bound = [&rows, chunks](size_type i) {return rows.begin() + rows.size() * std::min(i, chunks) / chunks;};
+
+        pool.for_each(chunks, [&](size_type i) {
+            std::stable_sort(bound(i), bound(i + 1), less);
+        });
+
+        for (size_type width = 1; width < chunks; width *= 2)
+            pool.for_each((chunks + width * 2 - 1) / (width * 2), [&](size_type i) {
+                auto first = i * width * 2;
+                std::inplace_merge(bound(first), bound(first + width), bound(first + width * 2), less);
+            });
+    }
+
+
+    void merge_runs(const vector_s& paths, size_type average_row_size) {
+        // Merges sorted runs into the output. Every run is read by batches, so all of them together take about half of the memory budget.
+        size_type rows_per_batch = std::max<size_type>(16, memory_budget / 2 / paths.size() / std::max<size_type>(average_row_size, 1));
+        CSVMerger(paths, output_path, key_columns, sep, quote, rows_per_batch).merge();
+    }
+};
+
+
+}
+
+
+#endif
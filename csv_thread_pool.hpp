@@ -0,0 +1,118 @@
+// Header with CSVThreadPool class.
+
+#ifndef CSV_MANAGER_CSV_THREAD_POOL
+#define CSV_MANAGER_CSV_THREAD_POOL
+
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <algorithm>
+#include <type_traits>
+
+
+namespace csvm {
+
+
+class CSVThreadPool {
+/* Fixed number of worker threads which execute submitted tasks in the order of submission.
+ * .submit() returns std::future with the result of the task, or with the exception it has thrown.
+ * The destructor waits until all submitted tasks are done.
+ */
+public:
+
+    using size_type = std::vector<std::thread>::size_type;
+
+
+    CSVThreadPool(unsigned threads = 0) {
+        // Starts workers. If threads is 0, the number of hardware threads is used.
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+
+        for (unsigned i = 0; i < threads; ++i)
+            workers.emplace_back(&CSVThreadPool::work, this);
+    }
+
+    CSVThreadPool(const CSVThreadPool&) = delete;
+    CSVThreadPool& operator=(const CSVThreadPool&) = delete;
+
+    ~CSVThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopped = true;
+        }
+        condition.notify_all();
+        for (auto& i : workers)
+            i.join();
+    }
+
+
+    size_type size() const {
+        return workers.size();
+    }
+
+
+    template <typename F> std::future<std::invoke_result_t<F>> submit(F function) {
+        // Adds a task into the queue.
+        auto task = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::move(function));
+        auto output = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.emplace_back([task]() {(*task)();});
+        }
+        condition.notify_one();
+        return output;
+    }
+
+
+    template <typename F> void for_each(size_type number, F function) {
+        // Calls function(i) for every i from 0 to number on workers and waits for all of them.
+        // Rethrows the first exception thrown by any call. Must not be called from a task of the same pool.
+        std::vector<std::future<void>> results;
+        results.reserve(number);
+        for (size_type i = 0; i < number; ++i)
+            results.push_back(submit([&function, i]() {function(i);}));
+
+        for (auto& i : results)
+            i.wait();
+        for (auto& i : results)
+            i.get();
+    }
+
+
+private:
+    // Workers, the queue of tasks and its synchronization.
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopped = false;
+
+
+    void work() {
+        // Takes tasks from the queue until the pool is stopped and the queue is empty.
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this]() {return stopped || !tasks.empty();});
+                if (tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+
+}
+
+
+#endif
@@ -0,0 +1,313 @@
+// Header with CSVTranscoder class.
+
+#ifndef CSV_MANAGER_CSV_TRANSCODER
+#define CSV_MANAGER_CSV_TRANSCODER
+
+
+#include <string>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "./csv_scanner.hpp"
+#include "./csv_sink.hpp"
+
+
+namespace csvm {
+
+
+class CSVTranscoder {
+/* Converts CSV text from one dialect (delimiter and quote) into another without parsing rows into strings.
+ *
+ * Fields are found with CSVScanner, which jumps between delimiters, quotes and line ends. In the same pass, unquoted fields are
+ * checked for characters which are special in the output dialect. Fields which don't have them are copied as they are,
+ * and so are quoted fields which stay quoted in the same way. Neighbouring copied bytes are written as one piece,
+ * so if only a few fields change, the output is written at nearly the speed of copying.
+ * Only the other fields are unescaped and escaped again.
+ *
+ * The output is quoted minimally, as CSVEncoder with QuoteMinimal writes it: a field is enclosed in quotes
+ * only if it contains the output delimiter, the output quote, CR or LF. Every row ends with line_end.
+ * Input rows end with LF or CRLF outside quotes, and a row may have any number of fields. Line ends inside quotes are kept as they are.
+ * Characters after the closing quote of a field are added to it, and an unclosed quote takes the rest of the input, like CSVParser does.
+ */
+public:
+
+    using size_type = std::string::size_type;
+
+
+    struct Stats {
+    // Numbers of transcoded rows and fields, and the number of fields which were copied without escaping.
+        size_type rows = 0;
+        size_type fields = 0;
+        size_type copied_fields = 0;
+    };
+
+
+    CSVTranscoder(std::string input_delimiter = ",", char input_quote = '"', std::string output_delimiter = ",", char output_quote = '"',
+                  std::string line_end = "\n") : input_delimiter{input_delimiter}, output_delimiter{output_delimiter},
+                  line_end{line_end}, input_quote{input_quote}, output_quote{output_quote},
+                  scanner{input_delimiter.substr(0, 1) + input_quote + output_delimiter.substr(0, 1) + output_quote + "\r\n"},
+                  output_scanner{output_delimiter.substr(0, 1) + output_quote + "\r\n"} {
+        // Raises std::invalid_argument if a delimiter is empty or contains its quote.
+        if (input_delimiter.empty() || output_delimiter.empty())
+            throw std::invalid_argument("The delimiter can't be empty.");
+        if (input_delimiter.find(input_quote) != std::string::npos || output_delimiter.find(output_quote) != std::string::npos)
+            throw std::invalid_argument("The quote can't be part of the delimiter.");
+    }
+
+
+    template <typename Sink> size_type transcode(const char* data, size_type size, Sink& sink) {
+        // Transcodes the text into the sink and returns the number of rows. Sinks are in "csv_sink.hpp".
+        Output<Sink> output{sink};
+        const char* begin = data;
+        const char* end = data + size;
+        size_type rows = 0;
+
+        while (begin != end) {
+            // One row: fields until a line end or the end of the text.
+            while (true) {
+                begin = field(begin, end, output);
+                ++statistics.fields;
+                if (begin == end || *begin == '\r' || *begin == '\n')
+                    break;
+
+                if (same_delimiter)
+                    output.copy(begin, begin + input_delimiter.size());
+                else
+                    output.write(output_delimiter.data(), output_delimiter.size());
+                begin += input_delimiter.size();
+            }
+
+            const char* line = begin;
+            if (begin != end)
+                begin += *begin == '\r' ? 2 : 1;
+            if (line_end.compare(0, line_end.size(), line, begin - line) == 0)
+                output.copy(line, begin);
+            else
+                output.write(line_end.data(), line_end.size());
+            ++rows;
+        }
+
+        output.flush();
+        statistics.rows += rows;
+        return rows;
+    }
+
+    template <typename Sink> size_type transcode(const std::string& input, Sink& sink) {
+        return transcode(input.data(), input.size(), sink);
+    }
+
+
+    size_type transcode_file(const std::string& input_path, const std::string& output_path, size_type buffer_size = 1 << 22) {
+        // Maps the input file, transcodes it into the output file through CSVFileSink, and returns the number of rows.
+        // Raises std::runtime_error if a file can't be opened, written or closed.
+        CSVMappedFile input(input_path);
+
+        int fd = ::open(output_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            throw std::runtime_error("Can't open the file \"" + output_path + "\".");
+
+        size_type rows;
+        try {
+            CSVFileSink sink(fd, buffer_size);
+            rows = transcode(input.data(), input.size(), sink);
+            sink.close();
+        }
+        catch (...) {
+            ::close(fd);
+            throw;
+        }
+        if (::close(fd) != 0)
+            throw std::runtime_error("Can't close the file \"" + output_path + "\".");
+        return rows;
+    }
+
+
+    const Stats& stats() const {
+        // Statistics of all transcoded text.
+        return statistics;
+    }
+
+
+private:
+    // Dialects.
+    const std::string input_delimiter, output_delimiter, line_end;
+    const char input_quote, output_quote;
+    const bool same_delimiter = input_delimiter == output_delimiter;
+
+    // Finds characters which are special in any dialect, and characters which are special in the output one.
+    const CSVScanner scanner, output_scanner;
+
+    // The buffer for fields which are unescaped.
+    std::string value;
+
+    Stats statistics;
+
+
+    template <typename Sink> class Output {
+    // Writes into the sink. Copied pieces of the input which follow each other are joined and written at once.
+    public:
+
+        Output(Sink& sink) : sink{sink} {}
+
+        void copy(const char* begin, const char* end) {
+            if (begin == end)
+                return;
+            if (begin != copied_end) {
+                flush();
+                copied_begin = begin;
+            }
+            copied_end = end;
+        }
+
+        void write(const char* data, size_type size) {
+            flush();
+            sink.write(data, size);
+        }
+
+        void flush() {
+            if (copied_begin != copied_end)
+                sink.write(copied_begin, copied_end - copied_begin);
+            copied_begin = copied_end = nullptr;
+        }
+
+    private:
+        Sink& sink;
+        const char* copied_begin = nullptr;
+        const char* copied_end = nullptr;
+    };
+
+
+    static bool matches(const char* begin, const char* end, const std::string& delimiter) {
+        // Checks if the delimiter starts at the position.
+        return static_cast<size_type>(end - begin) >= delimiter.size() && std::memcmp(begin, delimiter.data(), delimiter.size()) == 0;
+    }
+
+
+    const char* scan_plain(const char* begin, const char* end, bool& enclose, size_type& quotes) const {
+        // Finds the end of unquoted text: the input delimiter, CRLF, LF or the end. Finds out in the same pass if the text
+        // should be enclosed in the output, and counts output quotes in it.
+        while ((begin = scanner.find(begin, end)) != end) {
+            char c = *begin;
+            if (c == '\n' || (c == '\r' && begin + 1 != end && begin[1] == '\n'))
+                break;
+            if (c == input_delimiter[0] && matches(begin, end, input_delimiter))
+                break;
+
+            if (c == output_quote) {
+                ++quotes;
+                enclose = true;
+            }
+            else if (c == '\r' || (c == output_delimiter[0] && matches(begin, end, output_delimiter)))
+                enclose = true;
+            ++begin;
+        }
+        return begin;
+    }
+
+
+    bool classify(const char* begin, const char* end, size_type& quotes) const {
+        // Finds out if the value should be enclosed in the output, and counts output quotes in it.
+        bool enclose = false;
+        while ((begin = output_scanner.find(begin, end)) != end) {
+            if (*begin == output_quote) {
+                ++quotes;
+                enclose = true;
+            }
+            else if (*begin == '\r' || *begin == '\n' || matches(begin, end, output_delimiter))
+                enclose = true;
+            ++begin;
+        }
+        return enclose;
+    }
+
+
+    template <typename Sink> void escape(const char* begin, const char* end, bool enclose, size_type quotes, Output<Sink>& output) {
+        // Writes the value with doubled output quotes, enclosed if necessary.
+        if (enclose)
+            output.write(&output_quote, 1);
+        for (size_type i = 0; i < quotes; ++i) {
+            auto position = static_cast<const char*>(std::memchr(begin, output_quote, end - begin)) + 1;
+            output.write(begin, position - begin);
+            output.write(&output_quote, 1);
+            begin = position;
+        }
+        output.write(begin, end - begin);
+        if (enclose)
+            output.write(&output_quote, 1);
+    }
+
+
+    template <typename Sink> const char* field(const char* begin, const char* end, Output<Sink>& output) {
+        // Transcodes one field and returns the position after it: the delimiter, the line end or the end.
+        bool enclose = false;
+        size_type quotes = 0;
+
+        if (begin == end || *begin != input_quote) {
+            auto stop = scan_plain(begin, end, enclose, quotes);
+            if (enclose)
+                escape(begin, stop, true, quotes, output);
+            else {
+                output.copy(begin, stop);
+                ++statistics.copied_fields;
+            }
+            return stop;
+        }
+
+        // Finds the closing quote, skipping doubled ones.
+        const char* inner = begin + 1;
+        const char* closing = inner;
+        bool doubled = false, closed = false;
+        while ((closing = static_cast<const char*>(std::memchr(closing, input_quote, end - closing)))) {
+            if (closing + 1 != end && closing[1] == input_quote) {
+                doubled = true;
+                closing += 2;
+                continue;
+            }
+            closed = true;
+            break;
+        }
+        if (!closed)
+            closing = end;
+
+        const char* after = closed ? closing + 1 : end;
+        bool trailing_enclose = false;
+        size_type trailing_quotes = 0;
+        auto stop = scan_plain(after, end, trailing_enclose, trailing_quotes);
+
+        if (closed && after == stop && input_quote == output_quote) {
+            // The inner text is already escaped for the output, so the field is copied with or without its quotes.
+            if (classify(inner, closing, quotes))
+                output.copy(begin, after);
+            else
+                output.copy(inner, closing);
+            ++statistics.copied_fields;
+            return stop;
+        }
+
+        // Unescapes the value and escapes it again.
+        value.clear();
+        if (doubled) {
+            for (const char* i = inner; i != closing; ++i) {
+                value += *i;
+                if (*i == input_quote)
+                    ++i;
+            }
+        }
+        else
+            value.append(inner, closing);
+        value.append(after, stop);
+
+        enclose = classify(value.data(), value.data() + value.size(), quotes);
+        escape(value.data(), value.data() + value.size(), enclose, quotes, output);
+        return stop;
+    }
+};
+
+
+}
+
+
+#endif
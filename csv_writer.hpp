@@ -2,14 +2,27 @@
 #define CSV_MANAGER_CSV_WRITER
 
 
-#include <fstream>
 #include <vector>
 #include <string>
 #include <stdexcept>
 #include <array>
+#include <future>
+#include <thread>
+#include <algorithm>
+#include <memory>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include "./csv_encoder.hpp"
+#include "./csv_sink.hpp"
 #include "./csv_data.hpp"
+#include "./csv_parser.hpp"
+#include "./csv_scanner.hpp"
+#include "./csv_thread_pool.hpp"
 
 
 namespace csvm {
@@ -17,28 +30,210 @@ namespace csvm {
 
 class CSVWriter {
 // Writer which writes content of the CSVData to the file.
-// Use .write_all() to write everything.
+// Use .write_all() to write everything, .write_all_parallel() to encode it on many threads,
+// or .write_all_mapped() to encode it on many threads straight into the mapped file.
+// Encoded rows are collected in a big buffer, which is written into the file descriptor by CSVFileSink
+// when it's full, on .flush() and on .close(). The file is synced by the sync policy.
+// In the asynchronous mode, rows are encoded into one of async_buffers buffers, while a background thread writes
+// filled ones into the file. .write_all() returns when everything is encoded, and .await_complete() waits for the file.
+// In the append mode, the file isn't truncated and its header is checked instead of written. .write_all() writes
+// only rows from the first dirty row of the input (see CSVData change tracking), cutting the file where that row begins.
 //
 public:
 
     using vector_s = std::vector<std::string>;
     using vector_v_s = std::vector<vector_s>;
+    using size_type = CSVFileSink::size_type;
+    using Sync = CSVFileSink::Sync;
+    using Stats = CSVFileSink::Stats;
 
 
-    CSVWriter(CSVData &input, std::string path, std::string delimiter = ",", char quote = '"') : input{input},
-             path{path}, delimiter{delimiter}, quote{quote}, file{path} {
+    CSVWriter(CSVData &input, std::string path, std::string delimiter = ",", char quote = '"', bool append = false,
+              size_type buffer_size = 1 << 22, Sync sync = Sync::never, size_type sync_bytes = 64 << 20, size_type async_buffers = 0) :
+              input{input}, path{path}, delimiter{delimiter}, quote{quote}, append{append},
+              fd{::open(path.c_str(), O_RDWR | O_CREAT | (append ? 0 : O_TRUNC), 0644)},
+              sink{fd, async_buffers ? 1 : buffer_size, sync, sync_bytes} {
         // Initialization. Writes header.
-        file << input.get_header_line(delimiter, quote) + "\n";
+        // If append is true, the header of a non-empty file is checked instead, and std::invalid_argument is raised
+        // if it has other columns.
+        // buffer_size is the size of the buffer in bytes. sync is the policy of fsync() calls: never, on close,
+        // or periodic, every sync_bytes written bytes and on close.
+        // If async_buffers isn't 0, the writer is asynchronous and uses that many buffers of buffer_size bytes, at least 2.
+        // Then the file sink gets only whole buffers, so it doesn't need its own.
+        if (async_buffers)
+            async = std::make_unique<CSVAsyncSink<CSVFileSink>>(sink, buffer_size, async_buffers);
+        if (fd < 0)
+            return;
+
+        try {
+            auto size = ::lseek(fd, 0, SEEK_END);
+            if (append && size > 0)
+                check_header(size);
+            else {
+                auto header = input.get_header_line(delimiter, quote) + "\n";
+                put(header.data(), header.size());
+            }
+        }
+        catch (...) {
+            ::close(fd);
+            fd = -1;
+            throw;
+        }
     }
 
+    CSVWriter(const CSVWriter&) = delete;
+    CSVWriter& operator=(const CSVWriter&) = delete;
 
-    CSVWriter& write_all() {
+    ~CSVWriter() {
+        try {
+            close();
+        }
+        catch (...) {}
+    }
+
+
+    template <typename Quoting = QuoteMinimal> CSVWriter& write_all() {
         // Writes all the data from the input into the output file and closes it.
-        if (file) {
-            for (std::string i : encoder) {
-                file << i + "\n";
+        // Quoting is the quoting policy of rows from "csv_encoder.hpp". The header is always quoted minimally.
+        // In the asynchronous mode, returns when all rows are encoded, and the file is closed by .await_complete().
+        if (is_open()) {
+            auto& rows = input.get_values();
+            auto from = append ? seek_first_dirty_row() : 0;
+            put(CSVEncoder<CSVData::vector_v_s::iterator, Quoting>(rows.begin() + from, rows.end(), delimiter, quote));
+            input.mark_synced();
+            finish();
+        }
+        else
+            throw std::runtime_error("The file stream is closed.");
+
+        return *this;
+    }
+
+
+    template <typename Quoting = QuoteMinimal> CSVWriter& write_all_parallel(unsigned threads = 0, std::size_t block_rows = 16384) {
+        // Writes all the data from the input into the output file and closes it, encoding blocks of block_rows rows on threads.
+        // Blocks are written in order as soon as they are encoded, while later blocks are still being encoded.
+        // At most two blocks per thread are kept in memory. If threads is 0, the number of hardware threads is used.
+        if (!is_open())
+            throw std::runtime_error("The file stream is closed.");
+
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+
+        auto& rows = input.get_values();
+        std::size_t from = append ? seek_first_dirty_row() : 0;
+        block_rows = std::max<std::size_t>(block_rows, 1);
+        std::size_t blocks = (rows.size() - from + block_rows - 1) / block_rows;
+
+        // Every block is encoded into the buffer with its number modulo the window, so buffers are reused.
+        std::size_t window = threads * 2;
+        std::vector<CSVBufferSink> buffers(window);
+        std::vector<std::future<void>> encoded(window);
+
+        auto encode_block = [&](std::size_t block) {
+            auto begin = rows.begin() + from + block * block_rows;
+            auto end = rows.begin() + std::min(rows.size(), from + (block + 1) * block_rows);
+            auto& buffer = buffers[block % window].clear();
+            CSVEncoder<CSVData::vector_v_s::iterator, Quoting>(begin, end, delimiter, quote).encode_all(buffer);
+        };
+
+        // The pool is destroyed first, so it waits for running tasks even if an exception is thrown.
+        CSVThreadPool pool(threads);
+
+        for (std::size_t i = 0; i < std::min(blocks, window); ++i)
+            encoded[i] = pool.submit([&encode_block, i]() {encode_block(i);});
+
+        for (std::size_t i = 0; i < blocks; ++i) {
+            auto& result = encoded[i % window];
+            result.get();
+            auto& buffer = buffers[i % window].buffer;
+            put(buffer.data(), buffer.size());
+
+            if (i + window < blocks)
+                result = pool.submit([&encode_block, next = i + window]() {encode_block(next);});
+        }
+
+        input.mark_synced();
+        finish();
+
+        return *this;
+    }
+
+
+    template <typename Quoting = QuoteMinimal> CSVWriter& write_all_mapped(unsigned threads = 0, std::size_t block_rows = 16384) {
+        // Writes all the data from the input into the output file and closes it, with no single thread which all bytes go through.
+        // Encoded sizes of blocks of block_rows rows are computed on threads, and their prefix sums give offsets of blocks in the file.
+        // The file is extended to the final size with fallocate() and mapped, and threads encode blocks straight into their ranges.
+        // Bytes written through the mapping aren't counted by .stats(). Raises std::runtime_error if the file can't be mapped.
+        if (!is_open())
+            throw std::runtime_error("The file stream is closed.");
+
+        auto& rows = input.get_values();
+        std::size_t from = append ? seek_first_dirty_row() : 0;
+        drain();
+        off_t base = ::lseek(fd, 0, SEEK_CUR);
+
+        block_rows = std::max<std::size_t>(block_rows, 1);
+        std::size_t blocks = (rows.size() - from + block_rows - 1) / block_rows;
+        auto encoder = [&](std::size_t block) {
+            auto begin = rows.begin() + from + block * block_rows;
+            auto end = rows.begin() + std::min(rows.size(), from + (block + 1) * block_rows);
+            return CSVEncoder<CSVData::vector_v_s::iterator, Quoting>(begin, end, delimiter, quote);
+        };
+
+        CSVThreadPool pool(threads);
+
+        std::vector<std::size_t> offsets(blocks + 1, 0);
+        pool.for_each(blocks, [&](std::size_t i) {
+            offsets[i + 1] = encoder(i).encoded_size();
+        });
+        for (std::size_t i = 0; i < blocks; ++i)
+            offsets[i + 1] += offsets[i];
+
+        std::size_t total = offsets.back();
+        if (total) {
+            // The mapping must start at a page boundary, so it also covers the end of the header or of unchanged rows.
+            off_t page = ::sysconf(_SC_PAGESIZE);
+            off_t start = base / page * page;
+            std::size_t shift = base - start, length = shift + total;
+
+            int error = ::posix_fallocate(fd, base, total);
+            if (error == EINVAL || error == EOPNOTSUPP)
+                error = ::ftruncate(fd, base + total) ? errno : 0;
+            if (error)
+                throw std::runtime_error("Can't allocate the file \"" + path + "\": " + std::string(std::strerror(error)) + ".");
+
+            void* mapped = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, start);
+            if (mapped == MAP_FAILED)
+                throw std::runtime_error("Can't map the file \"" + path + "\".");
+            char* output = static_cast<char*>(mapped) + shift;
+
+            try {
+                pool.for_each(blocks, [&](std::size_t i) {
+                    CSVMemorySink range(output + offsets[i], offsets[i + 1] - offsets[i]);
+                    encoder(i).encode_all(range);
+                });
             }
-            close();
+            catch (...) {
+                ::munmap(mapped, length);
+                throw;
+            }
+            ::munmap(mapped, length);
+            ::lseek(fd, base + total, SEEK_SET);
+        }
+
+        input.mark_synced();
+        close();
+
+        return *this;
+    }
+
+
+    template <typename Quoting = QuoteMinimal> CSVWriter& write_batch(CSVData& batch) {
+        // Writes all rows of the batch into the output file without closing it. The batch should have the same columns as the input.
+        // Rows may stay in the buffer until it's full, or until .flush() or .close().
+        if (is_open()) {
+            put(batch.encode_content<Quoting>(delimiter, quote));
         }
         else
             throw std::runtime_error("The file stream is closed.");
@@ -47,20 +242,164 @@ public:
     }
 
 
+    CSVWriter& flush() {
+        // Writes buffered rows into the file. In the asynchronous mode, passes them to the background thread without waiting.
+        if (fd >= 0) {
+            if (async)
+                async->flush();
+            else
+                sink.flush();
+        }
+        return *this;
+    }
+
+
+    CSVWriter& await_complete() {
+        // Waits until all rows are written into the file, and closes it if everything has been written.
+        // Rethrows errors of the background thread.
+        if (async && fd >= 0) {
+            async->wait();
+            if (finished)
+                close();
+        }
+        return *this;
+    }
+
+
     CSVWriter& close() {
-        // Closes file.
-        file.close();
+        // Writes buffered rows, syncs the file by the policy and closes it.
+        if (fd >= 0) {
+            int closed = fd;
+            fd = -1;
+            try {
+                if (async)
+                    async->wait();
+                sink.close();
+            }
+            catch (...) {
+                ::close(closed);
+                throw;
+            }
+            if (::close(closed) != 0)
+                throw std::runtime_error("Can't close the file \"" + path + "\".");
+        }
         return *this;
     }
 
 
+    const Stats& stats() const {
+        // Written bytes and numbers of system calls. In the asynchronous mode, call it after .await_complete().
+        return sink.stats();
+    }
+
+
 private:
     // Attributes.
     CSVData &input;
     const std::string path, delimiter;
     const char quote;
-    std::ofstream file;
-    CSVEncoder<CSVData::vector_v_s::iterator> encoder = input.encode_content(delimiter, quote);
+    const bool append;
+    int fd;
+
+    // Encoded rows are collected in the buffer of the sink and written into the file by big pieces.
+    CSVFileSink sink;
+
+    // Buffers and the background thread of the asynchronous mode, and whether everything has been written into them.
+    std::unique_ptr<CSVAsyncSink<CSVFileSink>> async;
+    bool finished = false;
+
+
+    bool is_open() const {
+        return fd >= 0 && !finished;
+    }
+
+    template <typename Encoder> void put(Encoder&& encoder) {
+        // Encodes rows into the asynchronous buffers, or into the file sink.
+        if (async)
+            encoder.encode_all(*async);
+        else
+            encoder.encode_all(sink);
+    }
+
+    void put(const char* data, size_type size) {
+        if (async)
+            async->write(data, size);
+        else
+            sink.write(data, size);
+    }
+
+    void drain() {
+        // Waits until everything is written into the file.
+        if (async)
+            async->wait();
+        sink.flush();
+    }
+
+    void finish() {
+        // Closes the file after everything is written. In the asynchronous mode, only passes the last buffer to the background thread.
+        if (async) {
+            finished = true;
+            async->flush();
+        }
+        else
+            close();
+    }
+
+
+    off_t skip_lines(CSVData::index_type number) {
+        // Returns the offset after the given number of rows of the file, or -1 if there are fewer.
+        // Rows are found by CSVCounter, so a quote begins a quoted part only at the start of a field, as in the parser.
+        if (number == 0)
+            return 0;
+        if (::lseek(fd, 0, SEEK_END) <= 0)
+            return -1;
+
+        CSVMappedFile file(path);
+        CSVCounter counter(delimiter, quote);
+        const char* begin = file.data();
+        const char* end = begin + file.size();
+        const char* i = begin;
+        for (; number; --number) {
+            if (i == end)
+                return -1;
+            i = counter.row_end(i, end);
+            if (i[-1] != '\n')
+                return -1;
+        }
+        return i - begin;
+    }
+
+    void check_header(off_t size) {
+        // Compares the header of the file with columns of the input, and moves to the end of the file, after the line end.
+        auto end = skip_lines(1);
+        std::string line(end < 0 ? size : end, '\0');
+        if (::pread(fd, line.data(), line.size(), 0) != static_cast<ssize_t>(line.size()))
+            throw std::runtime_error("Can't read the header of the file \"" + path + "\".");
+        while (!line.empty() && (line.back() == '\n' || line.back() == '\r'))
+            line.pop_back();
+
+        vector_s lines = {line};
+        CSVParser<vector_s::iterator> parser(lines.begin(), lines.end(), delimiter, quote);
+        if (*parser.begin() != input.get_column_names())
+            throw std::invalid_argument("The header of the file \"" + path + "\" doesn't match columns of the data.");
+
+        char last;
+        if (::pread(fd, &last, 1, size - 1) == 1 && last != '\n')
+            put("\n", 1);
+    }
+
+    CSVData::index_type seek_first_dirty_row() {
+        // Cuts the file where the first dirty row of the input begins, and returns the index of that row.
+        // If only new rows were added, they are just written after the end of the file.
+        drain();
+        auto from = input.first_dirty_row();
+        off_t offset = from == input.file_row_number() ? ::lseek(fd, 0, SEEK_END) : skip_lines(from + 1);
+        if (offset < 0)
+            throw std::runtime_error("The file \"" + path + "\" has fewer rows than the data was synchronized with.");
+        if (::ftruncate(fd, offset) != 0 || ::lseek(fd, offset, SEEK_SET) < 0)
+            throw std::runtime_error("Can't cut the file \"" + path + "\".");
+        return from;
+    }
 };
 
 
@@ -5,11 +5,13 @@
 
 do_test() {
     path="$1"
-    g++ "${path}.cpp" -o "${path}" -Og && (exec "${path}") && printf "Ok " || printf "Bad "
+    libs=""
+    [ "$(basename "$path")" = "test_csv_gzip" ] && libs="-lz"
+    g++ "${path}.cpp" -o "${path}" -Og ${libs} && (exec "${path}") && printf "Ok " || printf "Bad "
 }
 
 
-tests="test_csv_data test_csv_reader test_csv_parser test_csv_encoder test_csv_writer"
+tests="test_csv_data test_csv_reader test_csv_parser test_csv_encoder test_csv_writer test_csv_appender test_csv_snapshot test_csv_arrow test_csv_thread_pool test_csv_sort test_csv_merge test_csv_sink test_csv_partition test_csv_gzip test_csv_pipeline test_csv_transcoder test_csv_lazy_data test_csv_scanner"
 
 dir="$(dirname "$0")"
 TIMEFORMAT=%R
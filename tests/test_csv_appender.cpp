@@ -0,0 +1,145 @@
+// Tests for csv_appender.hpp.
+
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+
+#include "../csv_appender.hpp"
+
+
+using vector_s = std::vector<std::string>;
+using vector_v_s = std::vector<vector_s>;
+
+
+void test_concurrent_append() {
+    // All rows from all producers should be in the output.
+    csvm::CSVData data;
+    data.add_column("producer").add_column("number");
+
+    {
+        csvm::CSVAppender appender(data, 16);
+        std::vector<std::thread> producers;
+
+        for (int p = 0; p < 4; ++p)
+            producers.emplace_back([&appender, p]() {
+                auto buffer = appender.buffer();
+                for (int i = 0; i < 1000; ++i)
+                    buffer.add_row({std::to_string(p), std::to_string(i)});
+            });
+
+        for (auto& i : producers)
+            i.join();
+    }
+
+    if (data.row_number() != 4000)
+        throw std::logic_error("CSVAppender has lost some rows.");
+
+    vector_v_s rows = data.get_values();
+    std::sort(rows.begin(), rows.end());
+    if (std::unique(rows.begin(), rows.end()) != rows.end())
+        throw std::logic_error("CSVAppender has duplicated some rows.");
+}
+
+
+void test_ordered_append() {
+    // The ordered appender should place rows sorted by their keys.
+    csvm::CSVData data;
+    data.add_column("key");
+
+    csvm::CSVAppender appender(data, 3, true);
+    std::vector<std::thread> producers;
+
+    for (int p = 0; p < 2; ++p)
+        producers.emplace_back([&appender, p]() {
+            auto buffer = appender.buffer();
+            for (int i = p; i < 20; i += 2)
+                buffer.add_row(i, {std::to_string(i)});
+        });
+
+    for (auto& i : producers)
+        i.join();
+
+    if (data.row_number() != 0)
+        throw std::logic_error("The ordered appender shouldn't touch the output before .close().");
+
+    appender.close();
+
+    for (int i = 0; i < 20; ++i)
+        if (data[i][0] != std::to_string(i))
+            throw std::logic_error("The ordered appender doesn't sort rows by key.");
+}
+
+
+void test_invalid_row() {
+    // Rows with the wrong number of fields should be rejected.
+    csvm::CSVData data;
+    data.add_column("first").add_column("second");
+
+    csvm::CSVAppender appender(data);
+    auto buffer = appender.buffer();
+
+    bool bad = false;
+    try {buffer.add_row({"only one"}); bad = true;} catch (std::invalid_argument) {}
+    try {buffer.add_row({"1", "2", "3"}); bad = true;} catch (std::invalid_argument) {}
+
+    if (bad)
+        throw std::logic_error("CSVAppender::Buffer doesn't prohibit addition of invalid rows.");
+
+    buffer.add_row({"1", "2"}).flush();
+
+    if (data.row_number() != 1)
+        throw std::logic_error(".flush() doesn't hand over rows.");
+}
+
+
+void test_buffer_after_close() {
+    // Buffers which outlive .close() or the appender should reject their rows instead of handing them over.
+    csvm::CSVData data;
+    data.add_column("key");
+
+    auto appender = std::make_unique<csvm::CSVAppender>(data, 10, true);
+    auto flushed = appender->buffer();
+    auto late = appender->buffer();
+    auto dropped = appender->buffer();
+    flushed.add_row(1, {"1"}).flush();
+    late.add_row(2, {"2"});
+    dropped.add_row(3, {"3"});
+
+    appender->close();
+    if (appender->is_open() || data.row_number() != 1)
+        throw std::logic_error("CSVAppender::close() doesn't place flushed rows.");
+
+    bool bad = false;
+    try {late.flush(); bad = true;} catch (std::logic_error) {}
+    try {late.add_row(4, {"4"}); bad = true;} catch (std::logic_error) {}
+    if (bad)
+        throw std::logic_error("CSVAppender::Buffer hands over rows after .close().");
+
+    appender.reset();
+    try {dropped.add_row(5, {"5"}); bad = true;} catch (std::logic_error) {}
+    if (bad)
+        throw std::logic_error("CSVAppender::Buffer takes rows after destruction of the appender.");
+
+    {auto moved = std::move(dropped);}
+    if (data.row_number() != 1)
+        throw std::logic_error("CSVAppender::Buffer hands over rows on destruction after .close().");
+}
+
+
+int main() {
+
+    test_concurrent_append();
+
+    test_ordered_append();
+
+    test_invalid_row();
+
+    test_buffer_after_close();
+
+    return 0;
+}
@@ -0,0 +1,215 @@
+// Tests for csv_arrow.hpp.
+
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <stdexcept>
+#include <cstring>
+
+#include "../csv_arrow.hpp"
+#include "../csv_sink.hpp"
+
+
+using vector_s = std::vector<std::string>;
+using vector_v_s = std::vector<vector_s>;
+
+
+csvm::CSVData make_data() {
+    // Creates the data used by tests.
+    csvm::CSVData data;
+    data.add_column("name").add_column("note");
+    data.add_row({{"Tom", ""}, {"Jane", "a,\"b\""}, {"", "x"}});
+    return data;
+}
+
+
+void test_column_layout() {
+    // Buffers of columns should match the Arrow utf8 layout.
+    auto data = make_data();
+    auto columns = csvm::CSVArrow::to_columns(data, true);
+
+    std::vector<std::int32_t> offsets_0 = {0, 3, 7, 7}, offsets_1 = {0, 0, 5, 6};
+    std::vector<std::uint8_t> validity_0 = {0b011}, validity_1 = {0b110};
+
+    if (columns.size() != 2 || columns[0].name != "name" || columns[1].name != "note")
+        throw std::logic_error("CSVArrow doesn't keep the order of columns.");
+
+    if (columns[0].offsets != offsets_0 || columns[0].data != "TomJane" || columns[0].validity != validity_0 ||
+        columns[0].null_count != 1 || columns[1].offsets != offsets_1 || columns[1].data != "a,\"b\"x" ||
+        columns[1].validity != validity_1 || columns[1].null_count != 1)
+        throw std::logic_error("CSVArrow builds invalid buffers.");
+
+    // Without nulls, the bitmap should be omitted.
+    columns = csvm::CSVArrow::to_columns(data);
+    if (!columns[0].validity.empty() || columns[0].null_count != 0)
+        throw std::logic_error("CSVArrow builds the bitmap for data without nulls.");
+}
+
+
+void test_export_import() {
+    // Exported structures should be imported back without changes.
+    auto data = make_data();
+    csvm::CSVData output;
+
+    ArrowArray array;
+    ArrowSchema schema;
+    csvm::CSVArrow::export_table(data, &array, &schema, true);
+
+    if (std::string(schema.format) != "+s" || schema.n_children != 2 || std::string(schema.children[1]->name) != "note" ||
+        std::string(schema.children[1]->format) != "u" || array.length != 3 || array.children[0]->n_buffers != 3 ||
+        static_cast<const std::int32_t*>(array.children[0]->buffers[1])[2] != 7)
+        throw std::logic_error("CSVArrow exports invalid structures.");
+
+    csvm::CSVArrow::import_table(output, &array, &schema);
+
+    if (output != data || output.get_column_names() != data.get_column_names())
+        throw std::logic_error("CSVArrow doesn't import exported data back.");
+
+    if (array.release || schema.release)
+        throw std::logic_error("CSVArrow doesn't release imported structures.");
+}
+
+
+int released = 0;
+void release_fixture_schema(ArrowSchema* schema) {schema->release = nullptr; ++released;}
+void release_fixture_array(ArrowArray* array) {array->release = nullptr; ++released;}
+
+
+void test_import_fixture() {
+    // A hand-built large utf8 column with a null and a slice offset should be imported.
+    std::uint8_t validity[] = {0b1011};
+    std::int64_t offsets[] = {0, 2, 5, 5, 9};
+    const char bytes[] = "abcdenull";
+    const void* buffers[] = {validity, offsets, bytes};
+
+    ArrowSchema child_schema{"U", "letters", nullptr, ARROW_FLAG_NULLABLE, 0, nullptr, nullptr, nullptr, nullptr};
+    ArrowSchema* schema_children[] = {&child_schema};
+    ArrowSchema schema{"+s", "", nullptr, 0, 1, schema_children, nullptr, &release_fixture_schema, nullptr};
+
+    ArrowArray child_array{4, 1, 0, 3, 0, buffers, nullptr, nullptr, nullptr, nullptr};
+    ArrowArray* array_children[] = {&child_array};
+    const void* struct_buffers[] = {nullptr};
+    ArrowArray array{3, 0, 1, 1, 1, struct_buffers, array_children, nullptr, &release_fixture_array, nullptr};
+
+    csvm::CSVData output;
+    csvm::CSVArrow::import_table(output, &array, &schema);
+
+    csvm::CSVData target;
+    target.add_column("letters").add_row({{"cde"}, {""}, {"null"}});
+
+    if (output != target || released != 2)
+        throw std::logic_error("CSVArrow doesn't import hand-built structures properly.");
+
+    // Other types should be rejected.
+    child_schema.format = "i";
+    schema.release = &release_fixture_schema;
+    array.release = &release_fixture_array;
+
+    bool bad = true;
+    try {csvm::CSVArrow::import_table(output, &array, &schema);} catch (std::invalid_argument) {bad = false;}
+
+    if (bad || released != 4)
+        throw std::logic_error("CSVArrow imports arrays of unsupported types.");
+
+    // A column without a name, which is shorter than the table, should be rejected too.
+    child_schema.format = "U";
+    child_schema.name = nullptr;
+    child_array.length = 3;
+    schema.release = &release_fixture_schema;
+    array.release = &release_fixture_array;
+
+    bad = true;
+    try {csvm::CSVArrow::import_table(output, &array, &schema);} catch (std::invalid_argument) {bad = false;}
+
+    if (bad || released != 6)
+        throw std::logic_error("CSVArrow imports columns shorter than the table.");
+}
+
+
+void test_large_utf8() {
+    // Large utf8 columns should have 64-bit offsets and be imported back.
+    auto data = make_data();
+    csvm::CSVData output;
+
+    auto columns = csvm::CSVArrow::to_columns(data, false, true);
+    if (!columns[0].large() || !columns[0].offsets.empty() || columns[0].large_offsets != std::vector<std::int64_t>{0, 3, 7, 7})
+        throw std::logic_error("CSVArrow doesn't build large utf8 buffers.");
+
+    ArrowArray array;
+    ArrowSchema schema;
+    csvm::CSVArrow::export_table(data, &array, &schema, false, true);
+    if (std::string(schema.children[0]->format) != "U" || static_cast<const std::int64_t*>(array.children[1]->buffers[1])[2] != 5)
+        throw std::logic_error("CSVArrow doesn't export large utf8 arrays.");
+
+    csvm::CSVArrow::import_table(output, &array, &schema);
+    if (output != data)
+        throw std::logic_error("CSVArrow doesn't import large utf8 arrays back.");
+}
+
+
+void test_import_repeated_names() {
+    // A table with repeated column names should be rejected without changing the data.
+    auto data = make_data();
+    ArrowArray array;
+    ArrowSchema schema;
+    csvm::CSVArrow::export_table(data, &array, &schema);
+    std::strcpy(const_cast<char*>(schema.children[1]->name), "name");
+
+    auto output = make_data();
+    bool bad = true;
+    try {csvm::CSVArrow::import_table(output, &array, &schema);} catch (std::invalid_argument&) {bad = false;}
+
+    if (bad || output != data || output.get_column_names() != vector_s{"name", "note"} || array.release || schema.release)
+        throw std::logic_error("CSVArrow changes the data when the import fails.");
+}
+
+
+void test_ipc() {
+    // The IPC stream should be the schema message, the record batch message with its body, and the end-of-stream marker.
+    // The body starts with the validity bitmap and the offsets of the first column, padded to 8 bytes.
+    // The file should also have magic strings, and the footer which points to the record batch.
+    auto data = make_data();
+    csvm::CSVBufferSink stream, file;
+    csvm::CSVArrow::write_ipc(data, stream, false, true);
+    csvm::CSVArrow::write_ipc(data, file, true, true);
+    auto& bytes = stream.buffer;
+
+    auto read_32 = [](const std::string& bytes, std::size_t at) {
+        std::int32_t value;
+        std::memcpy(&value, bytes.data() + at, 4);
+        return value;
+    };
+
+    std::size_t batch = 8 + read_32(bytes, 4);
+    std::size_t body = batch + 8 + read_32(bytes, batch + 4);
+    if (read_32(bytes, 0) != -1 || read_32(bytes, batch) != -1 || batch % 8 || body % 8 || bytes.size() % 8)
+        throw std::logic_error("CSVArrow doesn't write encapsulated IPC messages.");
+    if (bytes.compare(body + 24, 7, "TomJane") != 0 || bytes.compare(bytes.size() - 8, 8, std::string(4, '\xFF') + std::string(4, '\0')) != 0)
+        throw std::logic_error("CSVArrow doesn't write the record batch body and the end of the stream.");
+
+    auto& content = file.buffer;
+    std::size_t footer = content.size() - 10 - read_32(content, content.size() - 10);
+    if (content.compare(0, 8, std::string("ARROW1\0\0", 8)) != 0 || content.compare(content.size() - 6, 6, "ARROW1") != 0 ||
+        content.compare(8, bytes.size(), bytes) != 0 || footer != 8 + bytes.size())
+        throw std::logic_error("CSVArrow doesn't write the IPC file format.");
+}
+
+
+int main() {
+
+    test_column_layout();
+
+    test_export_import();
+
+    test_import_fixture();
+
+    test_large_utf8();
+
+    test_import_repeated_names();
+
+    test_ipc();
+
+    return 0;
+}
@@ -4,10 +4,15 @@
 #include <iostream>
 #include <string>
 #include <stdexcept>
+#include <filesystem>
+#include <algorithm>
 
 #include "../csv_data.hpp"
 
 
+std::string file_path = __FILE__;
+std::string current_dir = file_path.substr(0, file_path.find_last_of("/\\"));
+
 
 template <typename T> void print_1d(T seq) {
     // Prints content of one dimensional sequence.
@@ -180,6 +185,28 @@ void test_add_row_3() {
 }
 
 
+void test_add_row_4() {
+    // Test of .reserve() and .add_row_unchecked(), which should move rows into the reserved storage.
+
+    csvm::CSVData data({{"message", 0}, {"number", 1}}, {});
+    data.reserve(10);
+    auto storage = data.get_values().data();
+
+    std::string long_field(100, 'x');
+    std::vector<std::string> row = {long_field, "1"};
+    auto field_storage = row[0].data();
+
+    for (int i = 0; i < 10; ++i)
+        data.add_row_unchecked({"text", std::to_string(i)});
+    data.delete_row(9).add_row_unchecked(std::move(row));
+
+    if (data.get_values().capacity() < 10 || data.get_values().data() != storage || data.row_number() != 10)
+        throw std::logic_error(".reserve() doesn't reserve rows.");
+    if (data[9] != std::vector<std::string>{long_field, "1"} || data.get_values()[9][0].data() != field_storage || data[3][1] != "3")
+        throw std::logic_error(".add_row_unchecked() doesn't move rows.");
+}
+
+
 void test_insert_row_1() {
     // Test of all valid variants of .insert_row() use.
 
@@ -300,6 +327,170 @@ void test_string_representation() {
 }
 
 
+void test_memory_usage() {
+    // Does .memory_usage() count fields correctly, and does .shrink_to_fit() remove spare capacity?
+    std::string long_field(100, 'x');
+
+    csvm::CSVData data;
+    data.add_column("short").add_column("long");
+    data.get_values().reserve(10);
+    data.add_row({{"a", long_field}, {"bc", long_field}});
+
+    auto usage = data.memory_usage();
+    auto& short_column = usage.columns[0];
+    auto& long_column = usage.columns[1];
+
+    if (usage.columns.size() != 2 || short_column.name != "short" || long_column.name != "long")
+        throw std::logic_error(".memory_usage() doesn't report columns in their order.");
+
+    if (short_column.payload_bytes != 3 || short_column.sso_fields != 2 || short_column.heap_fields != 0 ||
+        short_column.heap_bytes != 0 || short_column.object_bytes != 2 * sizeof(std::string))
+        throw std::logic_error(".memory_usage() doesn't count small fields properly.");
+
+    if (long_column.payload_bytes != 200 || long_column.heap_fields != 2 || long_column.heap_bytes < 202)
+        throw std::logic_error(".memory_usage() doesn't count heap fields properly.");
+
+    if (usage.spare_row_bytes != 8 * sizeof(std::vector<std::string>) || usage.index_bytes == 0 ||
+        usage.total() <= usage.row_bytes + long_column.heap_bytes)
+        throw std::logic_error(".memory_usage() doesn't count the overhead properly.");
+
+    data.shrink_to_fit();
+    usage = data.memory_usage();
+
+    if (usage.spare_row_bytes != 0 || usage.spare_field_bytes != 0 || data[1][1] != long_field)
+        throw std::logic_error(".shrink_to_fit() doesn't remove spare capacity.");
+}
+
+
+void test_memory_usage_deleted_column() {
+    // Columns should follow fields of rows after a column which isn't the last is deleted.
+    csvm::CSVData data;
+    data.add_column("a").add_column("b").add_column("c");
+    data.add_row({"1", "22", std::string(100, 'x')});
+    data.delete_column("a");
+
+    auto usage = data.memory_usage();
+    if (usage.columns.size() != 2 || usage.columns[0].name != "b" || usage.columns[1].name != "c" ||
+        usage.columns[0].payload_bytes != 2 || usage.columns[1].payload_bytes != 100)
+        throw std::logic_error(".memory_usage() doesn't report columns after .delete_column().");
+}
+
+
+void test_memory_usage_sampled() {
+    // A sampled report should measure only some rows and be close to the full one. It should work on constant data.
+    std::string long_field(100, 'x');
+
+    csvm::CSVData data;
+    data.add_column("text").add_column("number");
+    for (int i = 0; i < 10000; ++i)
+        data.add_row({i % 3 ? "a" : long_field, std::to_string(i % 10)});
+
+    const csvm::CSVData& view = data;
+    auto full = view.memory_usage();
+    auto sampled = view.memory_usage(100);
+
+    auto close = [](std::size_t estimate, std::size_t exact) {
+        return estimate * 100 >= exact * 95 && estimate * 100 <= exact * 105;
+    };
+
+    if (full.columns[0].heap_fields != 3334 || !close(sampled.columns[0].heap_fields, 3334) ||
+        !close(sampled.columns[0].payload_bytes, full.columns[0].payload_bytes) || !close(sampled.total(), full.total()))
+        throw std::logic_error(".memory_usage() doesn't estimate memory from sampled rows.");
+
+    if (sampled.columns[1].payload_bytes != full.columns[1].payload_bytes || sampled.columns[1].object_bytes != full.columns[1].object_bytes ||
+        sampled.row_bytes != full.row_bytes || sampled.index_bytes != full.index_bytes || sampled.columns[1].name != "number")
+        throw std::logic_error(".memory_usage() doesn't scale sampled numbers to all rows.");
+}
+
+
+void test_distinct() {
+    // Does .distinct() delete duplicate rows and keep the right ones?
+    csvm::CSVData data({{"key", 0}, {"value", 1}}, {{"a", "1"}, {"b", "2"}, {"a", "1"}, {"a", "2"}, {"b", "2"}, {"ab", ""}, {"a", "b"}});
+    csvm::CSVData first = data, last = data, unordered = data;
+
+    first.distinct();
+    if (first.get_values() != csvm::CSVData::vector_v_s{{"a", "1"}, {"b", "2"}, {"a", "2"}, {"ab", ""}, {"a", "b"}})
+        throw std::logic_error(".distinct() doesn't keep first unique rows in order.");
+
+    last.distinct(false);
+    if (last.get_values() != csvm::CSVData::vector_v_s{{"a", "1"}, {"a", "2"}, {"b", "2"}, {"ab", ""}, {"a", "b"}})
+        throw std::logic_error(".distinct(false) doesn't keep last unique rows in order.");
+
+    unordered.distinct(true, false);
+    auto sorted_output = unordered.get_values(), sorted_target = first.get_values();
+    std::sort(sorted_output.begin(), sorted_output.end());
+    std::sort(sorted_target.begin(), sorted_target.end());
+    if (sorted_output != sorted_target)
+        throw std::logic_error(".distinct(true, false) doesn't keep the right rows.");
+
+    data.distinct_by({"key"});
+    if (data.get_values() != csvm::CSVData::vector_v_s{{"a", "1"}, {"b", "2"}, {"ab", ""}})
+        throw std::logic_error(".distinct_by() doesn't compare only given columns.");
+
+    bool bad = true;
+    try {data.distinct_by({"missing"});} catch (std::invalid_argument) {bad = false;}
+    if (bad)
+        throw std::logic_error(".distinct_by() takes a non-existing column name.");
+}
+
+
+void test_distinct_parallel() {
+    // Many threads should give the same result as one.
+    csvm::CSVData data;
+    data.add_column("first").add_column("second");
+    for (int i = 0; i < 50000; ++i)
+        data.add_row({std::to_string(i % 997), std::to_string(i % 13)});
+
+    csvm::CSVData single = data;
+    single.distinct(true, true, 1);
+    data.distinct(true, true, 4);
+
+    if (data != single || data.row_number() != 997 * 13)
+        throw std::logic_error(".distinct() with many threads gives a wrong result.");
+}
+
+
+void test_change_tracking() {
+    // Methods which move rows should lower the first dirty row, and new rows should stay after it.
+    csvm::CSVData data;
+    data.add_column("value");
+    for (int i = 0; i < 10; ++i)
+        data.add_row({std::to_string(i)});
+
+    if (data.first_dirty_row() != 0 || !data.is_dirty())
+        throw std::logic_error("New data isn't dirty.");
+
+    data.mark_synced();
+    if (data.first_dirty_row() != 10 || data.file_row_number() != 10 || data.is_dirty())
+        throw std::logic_error("Synced data is dirty.");
+
+    data.add_row({"10"});
+    if (data.first_dirty_row() != 10 || !data.is_dirty())
+        throw std::logic_error("Added rows aren't tracked.");
+
+    data.mark_dirty(7);
+    data.insert_row(8, {"x"});
+    if (data.first_dirty_row() != 7)
+        throw std::logic_error("The first dirty row isn't the smallest changed one.");
+
+    data.delete_row(3);
+    data.distinct();
+    if (data.first_dirty_row() != 3 || data.file_row_number() != 10)
+        throw std::logic_error("Deleted rows aren't tracked.");
+
+    data.mark_synced();
+    data.add_column("other");
+    if (data.first_dirty_row() != 0)
+        throw std::logic_error("Changes of columns aren't tracked.");
+
+    try {
+        data.mark_dirty(100);
+        throw std::logic_error("Rows out of bounds can be marked.");
+    }
+    catch (std::invalid_argument&) {}
+}
+
+
 int main() {
     // Runs all tests. If terminates without exceptions - everything good.
 
@@ -316,6 +507,7 @@ int main() {
     test_add_row_1();
     test_add_row_2();
     test_add_row_3();
+    test_add_row_4();
 
     test_insert_row_1();
     test_insert_row_2();
@@ -328,5 +520,14 @@ int main() {
 
     test_string_representation();
 
+    test_memory_usage();
+    test_memory_usage_deleted_column();
+    test_memory_usage_sampled();
+
+    test_distinct();
+    test_distinct_parallel();
+
+    test_change_tracking();
+
     return 0;
 }
@@ -28,7 +28,7 @@ template <typename T> void print_2d(T seq) {
 }
 
 
-template <typename T> void check_correctness(csvm::CSVEncoder<T> &encoder, const vector_s &correct,
+template <typename T, typename Q> void check_correctness(csvm::CSVEncoder<T, Q> &encoder, const vector_s &correct,
                        const std::string &message = "The encoder doesn't work right.") {
     // Method for comparison of the encoder output and the correct one.
     vector_s output;
@@ -124,6 +124,95 @@ void test_parser_and_encoder() {
 
 
 
+void test_many_quotes() {
+    // Every quote should be doubled, wherever it is.
+    vector_v_s source = {{"a\"b\"c", "\"\"", "\"", "plain"}, {"x\"\"\"y", "a,b", "ab"}};
+    vector_s target = {"\"a\"\"b\"\"c\",\"\"\"\"\"\",\"\"\"\",plain", "\"x\"\"\"\"\"\"y\",\"a,b\",ab"};
+
+    csvm::CSVEncoder<vector_v_s::iterator> encoder(source.begin(), source.end());
+
+    check_correctness(encoder, target);
+}
+
+
+void test_append_to() {
+    // .append_to() should append rows to the output, and the encoder should reuse its string.
+    vector_v_s source = {{std::string(100, 'x'), "a|b"}, {"short", "row"}};
+    csvm::CSVEncoder<vector_v_s::iterator>::Encoder encoder(source.begin(), "|");
+
+    std::string output = "start ";
+    encoder.append_to(output);
+    if (output != "start " + std::string(100, 'x') + "|\"a|b\"")
+        throw std::logic_error(".append_to() doesn't append the encoded row.");
+
+    auto capacity = encoder.encode().string.capacity();
+    if (encoder.next().encode().string != "short|row" || encoder.string.capacity() != capacity)
+        throw std::logic_error(".encode() doesn't reuse the string.");
+}
+
+
+std::string reference_field(const std::string& field, const std::string& delimiter, char quote) {
+    // The simplest correct encoding of one field.
+    std::string output;
+    for (char c : field) {
+        output += c;
+        if (c == quote)
+            output += c;
+    }
+    if (field.find(delimiter) != std::string::npos || field.find_first_of(std::string("\r\n") + quote) != std::string::npos)
+        output = quote + output + quote;
+    return output;
+}
+
+
+void test_long_fields() {
+    // Special characters should be found at any position of long fields, which are checked by blocks.
+    std::string specials[] = {"\"", "\r", "\n", "<", "<|>", "<|", "|>"};
+
+    for (std::size_t size = 0; size < 70; ++size)
+        for (auto& special : specials)
+            for (std::size_t position = 0; position <= size; ++position) {
+                std::string field(size, 'a');
+                field.insert(position, special);
+                if (position % 3 == 0)
+                    field += special;
+
+                vector_v_s source = {{field, "b"}};
+                vector_s target = {reference_field(field, "<|>", '"') + "<|>b"};
+                csvm::CSVEncoder<vector_v_s::iterator> encoder(source.begin(), source.end(), "<|>");
+
+                check_correctness(encoder, target, "The encoder doesn't classify long fields properly.");
+            }
+}
+
+
+void test_quoting_policies() {
+    // Every quoting policy should enclose its own fields.
+    vector_v_s source = {{"12", "-1.5e+3", "text", "a,b", "q\"", "", ".", "1e"}};
+
+    csvm::CSVEncoder<vector_v_s::iterator, csvm::QuoteMinimal> minimal(source.begin(), source.end());
+    check_correctness(minimal, {"12,-1.5e+3,text,\"a,b\",\"q\"\"\",,.,1e"}, "QuoteMinimal doesn't work right.");
+
+    csvm::CSVEncoder<vector_v_s::iterator, csvm::QuoteAll> all(source.begin(), source.end());
+    check_correctness(all, {"\"12\",\"-1.5e+3\",\"text\",\"a,b\",\"q\"\"\",\"\",\".\",\"1e\""}, "QuoteAll doesn't work right.");
+
+    csvm::CSVEncoder<vector_v_s::iterator, csvm::QuoteNonNumeric> non_numeric(source.begin(), source.end());
+    check_correctness(non_numeric, {"12,-1.5e+3,\"text\",\"a,b\",\"q\"\"\",\"\",\".\",\"1e\""}, "QuoteNonNumeric doesn't work right.");
+
+    // Numbers which contain the delimiter should be quoted too, so they are read back as one field.
+    vector_v_s numbers = {{"1.5", "-2", "3e-1", "12"}};
+    csvm::CSVEncoder<vector_v_s::iterator, csvm::QuoteNonNumeric> point(numbers.begin(), numbers.end(), ".");
+    check_correctness(point, {"\"1.5\".-2.3e-1.12"}, "QuoteNonNumeric doesn't quote numbers with the delimiter \".\".");
+    csvm::CSVEncoder<vector_v_s::iterator, csvm::QuoteNonNumeric> minus(numbers.begin(), numbers.end(), "-");
+    check_correctness(minus, {"1.5-\"-2\"-\"3e-1\"-12"}, "QuoteNonNumeric doesn't quote numbers with the delimiter \"-\".");
+    csvm::CSVEncoder<vector_v_s::iterator, csvm::QuoteNonNumeric> digits(numbers.begin(), numbers.end(), "12");
+    check_correctness(digits, {"1.512-2123e-112\"12\""}, "QuoteNonNumeric doesn't quote numbers with a multi-character delimiter.");
+
+    csvm::CSVEncoder<vector_v_s::iterator, csvm::QuoteNever> never(source.begin(), source.end());
+    check_correctness(never, {"12,-1.5e+3,text,a,b,q\",,.,1e"}, "QuoteNever doesn't work right.");
+}
+
+
 int main() {
 
     test_simple_1();
@@ -138,5 +227,13 @@ int main() {
 
     test_parser_and_encoder();
 
+    test_many_quotes();
+
+    test_append_to();
+
+    test_long_fields();
+
+    test_quoting_policies();
+
     return 0;
 }
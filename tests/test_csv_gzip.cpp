@@ -0,0 +1,213 @@
+// Tests for csv_gzip.hpp. Link with -lz.
+
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <stdexcept>
+#include <filesystem>
+
+#include <zlib.h>
+
+#include "../csv_gzip.hpp"
+#include "../csv_reader.hpp"
+
+
+using vector_s = std::vector<std::string>;
+using vector_v_s = std::vector<vector_s>;
+
+
+std::string file_path = __FILE__;
+std::string current_dir = file_path.substr(0, file_path.find_last_of("/\\"));
+
+
+csvm::CSVData sample_data(std::size_t rows) {
+    // Data with quoted fields and enough rows for many chunks.
+    csvm::CSVData data;
+    data.add_column("Id").add_column("Text").add_column("Number");
+    for (std::size_t i = 0; i < rows; ++i)
+        data.add_row({std::to_string(i), i % 7 ? "plain text " + std::to_string(i * i) : "say \"hi\", then go",
+                      std::to_string(i * 0.25)});
+    return data;
+}
+
+
+void test_round_trip() {
+    // Data written by CSVGzipWriter should be read back by CSVReader through CSVGzipInput, with and without the background thread.
+    std::string path = current_dir + "/assets/gzip_1.csv.gz";
+    auto data = sample_data(50000);
+
+    for (bool background : {true, false})
+        for (int level : {1, 6, 9}) {
+            csvm::CSVGzipWriter writer(data, path, ";", '"', level, background);
+            writer.write_all();
+
+            if (writer.stats().bytes != std::filesystem::file_size(path))
+                throw std::logic_error("CSVGzipWriter doesn't count written bytes.");
+            if (writer.stats().bytes * 2 > std::string(data).size())
+                throw std::logic_error("CSVGzipWriter doesn't compress the data.");
+
+            csvm::CSVData output;
+            csvm::CSVReader reader(output, std::make_unique<csvm::CSVGzipInput>(path, 4096, 2), ";", '"');
+            reader.read_all();
+            if (output != data)
+                throw std::logic_error("The data read from the gzip file isn't the same as the written data.");
+        }
+
+    std::filesystem::remove(path);
+}
+
+
+void test_write_batch() {
+    // Batches should be compressed into one stream after the header.
+    std::string path = current_dir + "/assets/gzip_2.csv.gz";
+    auto data = sample_data(10), batch = sample_data(5);
+
+    {
+        csvm::CSVGzipWriter writer(data, path);
+        writer.write_batch(data).write_batch(batch);
+    }
+
+    csvm::CSVData output;
+    csvm::CSVReader(output, csvm::CSVGzipInput::open(path)).read_all();
+    if (output.get_values().size() != 15 || output.get_values()[12] != batch.get_values()[2])
+        throw std::logic_error("CSVGzipWriter doesn't write batches.");
+
+    std::filesystem::remove(path);
+}
+
+
+void test_concatenated_members() {
+    // A file of many gzip members should be read as one stream, like gzip does.
+    std::string path = current_dir + "/assets/gzip_3.csv.gz";
+    std::string parts[] = {"A,B\n1,2\n", "3,4\n5,", "6\n"};
+
+    for (auto& i : parts) {
+        auto file = gzopen(path.c_str(), "ab");
+        gzwrite(file, i.data(), i.size());
+        gzclose(file);
+    }
+
+    csvm::CSVData output;
+    csvm::CSVReader(output, std::make_unique<csvm::CSVGzipInput>(path, 3, 1)).read_all();
+    if (output.get_column_names() != vector_s{"A", "B"} || output.get_values() != vector_v_s{{"1", "2"}, {"3", "4"}, {"5", "6"}})
+        throw std::logic_error("CSVGzipInput doesn't read concatenated members.");
+
+    std::filesystem::remove(path);
+}
+
+
+void test_trailing_bytes() {
+    // Zero padding after members should be ignored, and other trailing bytes reported after all the decoded rows.
+    std::string path = current_dir + "/assets/gzip_7.csv.gz";
+    std::filesystem::remove(path);
+    for (auto& i : {"A,B\n1,2\n", "3,4\n"}) {
+        auto file = gzopen(path.c_str(), "ab");
+        gzwrite(file, i, std::strlen(i));
+        gzclose(file);
+        std::ofstream(path, std::ios::binary | std::ios::app) << std::string(700, '\0');
+    }
+
+    csvm::CSVData output;
+    csvm::CSVReader(output, std::make_unique<csvm::CSVGzipInput>(path, 3, 1)).read_all();
+    if (output.get_values() != vector_v_s{{"1", "2"}, {"3", "4"}})
+        throw std::logic_error("CSVGzipInput doesn't ignore zero padding.");
+
+    std::ofstream(path, std::ios::binary | std::ios::app) << "junk" << std::string(300, '\0');
+    std::string message;
+    output = csvm::CSVData();
+    try {
+        csvm::CSVReader(output, std::make_unique<csvm::CSVGzipInput>(path, 3, 1)).read_all();
+    }
+    catch (const std::runtime_error& error) {
+        message = error.what();
+    }
+    if (message.find(" 304 trailing bytes") == std::string::npos || output.get_values() != vector_v_s{{"1", "2"}, {"3", "4"}})
+        throw std::logic_error("CSVGzipInput doesn't report trailing bytes after the decoded rows.");
+
+    std::filesystem::remove(path);
+}
+
+
+void test_plain_file() {
+    // CSVGzipInput::open() should open a file without the gzip magic number as it is.
+    std::string path = current_dir + "/assets/gzip_4.csv";
+    std::ofstream(path) << "A,B\n1,2\n";
+
+    csvm::CSVData output;
+    csvm::CSVReader(output, csvm::CSVGzipInput::open(path)).read_all();
+    if (output.get_values() != vector_v_s{{"1", "2"}})
+        throw std::logic_error("CSVGzipInput::open() doesn't read plain files.");
+
+    std::filesystem::remove(path);
+}
+
+
+void test_broken_file() {
+    // Reading a truncated or corrupted file should raise std::runtime_error.
+    std::string path = current_dir + "/assets/gzip_5.csv.gz";
+    auto data = sample_data(20000);
+    csvm::CSVGzipWriter(data, path).write_all();
+
+    auto size = std::filesystem::file_size(path);
+    std::string content(size, '\0');
+    std::ifstream(path, std::ios::binary).read(content.data(), size);
+
+    std::string broken[] = {content.substr(0, size / 2), content};
+    broken[1][size / 2] ^= 0x55;
+    broken[1][size / 2 + 1] ^= 0x55;
+
+    for (auto& i : broken) {
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << i;
+        bool raised = false;
+        try {
+            csvm::CSVData output;
+            csvm::CSVReader(output, std::make_unique<csvm::CSVGzipInput>(path, 4096, 2)).read_all();
+        }
+        catch (const std::runtime_error&) {
+            raised = true;
+        }
+        if (!raised)
+            throw std::logic_error("CSVGzipInput doesn't raise an exception on broken files.");
+    }
+
+    std::filesystem::remove(path);
+}
+
+
+void test_early_close() {
+    // Destroying the reader before the end of the file should stop decompression.
+    std::string path = current_dir + "/assets/gzip_6.csv.gz";
+    auto data = sample_data(50000);
+    csvm::CSVGzipWriter(data, path).write_all();
+
+    csvm::CSVData output;
+    csvm::CSVReader reader(output, std::make_unique<csvm::CSVGzipInput>(path, 1024, 1));
+    reader.read_line();
+    if (output.get_values().size() != 1)
+        throw std::logic_error("CSVGzipInput doesn't work with .read_line().");
+
+    std::filesystem::remove(path);
+}
+
+
+int main() {
+
+    test_round_trip();
+
+    test_write_batch();
+
+    test_concatenated_members();
+
+    test_trailing_bytes();
+
+    test_plain_file();
+
+    test_broken_file();
+
+    test_early_close();
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+// Tests for csv_lazy_data.hpp
+
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <filesystem>
+
+#include "../csv_lazy_data.hpp"
+#include "../csv_reader.hpp"
+#include "../csv_writer.hpp"
+
+
+using vector_s = std::vector<std::string>;
+using vector_v_s = std::vector<vector_s>;
+
+
+std::string file_path = __FILE__;
+std::string current_dir = file_path.substr(0, file_path.find_last_of("/\\"));
+
+
+void test_same_as_reader() {
+    // Rows should be the same as CSVReader reads, in any order of access, while the cache stays bounded.
+    std::string path = current_dir + "/assets/lazy_1.csv";
+    csvm::CSVData data;
+    data.add_column("Id").add_column("Text").add_column("Other");
+    for (int i = 0; i < 500; ++i)
+        data.add_row({std::to_string(i), i % 4 ? "text <|> " + std::to_string(i) : "say \"hi\", then go", i % 3 ? "" : "<|"});
+    csvm::CSVWriter(data, path, "<|>").write_all();
+
+    csvm::CSVData target;
+    csvm::CSVReader(target, path, "<|>").read_all();
+
+    csvm::CSVLazyData lazy(path, "<|>", '"', 7, 3);
+    if (lazy.row_number() != 500 || lazy.get_column_names() != vector_s{"Id", "Text", "Other"} || lazy.cached_blocks() != 0)
+        throw std::logic_error("CSVLazyData doesn't read the header and count rows.");
+
+    for (std::size_t i = 0; i < 500; ++i)
+        if (lazy[i] != target.get_values()[i])
+            throw std::logic_error("CSVLazyData doesn't parse the row " + std::to_string(i) + ".");
+
+    for (std::size_t i = 0; i < 500; i += 37)
+        if (lazy.get_row(499 - i) != target.get_values()[499 - i] || lazy.get_field(i, "Text") != target.get_values()[i][1])
+            throw std::logic_error("CSVLazyData doesn't parse rows in any order.");
+
+    if (lazy.cached_blocks() != 3)
+        throw std::logic_error("CSVLazyData doesn't bound the cache.");
+
+    auto misses = lazy.stats().misses;
+    lazy.get_row(1);
+    lazy.get_row(2);
+    if (lazy.stats().misses != misses + 1 || lazy.stats().hits == 0)
+        throw std::logic_error("CSVLazyData doesn't keep recently used blocks.");
+
+    if (lazy.get_column("Id") != csvm::CSVLazyData::vector_s(target.column("Id").begin(), target.column("Id").end()))
+        throw std::logic_error("CSVLazyData::get_column() doesn't return the column.");
+
+    std::filesystem::remove(path);
+}
+
+
+void test_quoted_rows() {
+    // Quoted line ends shouldn't end rows, and CRLF line ends should.
+    std::string path = current_dir + "/assets/lazy_2.csv";
+    std::ofstream(path, std::ios::binary) << "A,B\r\n1,\"x\ny\"\r\n2,\"p\"\"q\"tail,extra\n\n3,a\"b\n\"4\",\"unclosed\n5";
+
+    csvm::CSVLazyData lazy(path, ",", '"', 2, 1);
+    vector_v_s target = {{"1", "x\ny"}, {"2", "p\"qtail"}, {"", ""}, {"3", "a\"b"}, {"4", "unclosed\n5"}};
+
+    if (lazy.row_number() != target.size())
+        throw std::logic_error("CSVLazyData doesn't find rows with quoted line ends.");
+    for (std::size_t i = 0; i < target.size(); ++i)
+        if (lazy[i] != target[i])
+            throw std::logic_error("CSVLazyData doesn't parse quoted fields in the row " + std::to_string(i) + ".");
+
+    std::filesystem::remove(path);
+}
+
+
+void test_errors() {
+    // Wrong rows and columns should raise std::invalid_argument, and an empty file should have nothing.
+    std::string path = current_dir + "/assets/lazy_3.csv";
+    std::ofstream(path) << "A,B\n1,2\n";
+
+    csvm::CSVLazyData lazy(path);
+    for (int i = 0; i < 2; ++i) {
+        bool raised = false;
+        try {
+            if (i == 0)
+                lazy.get_row(1);
+            else
+                lazy.get_column("C");
+        }
+        catch (const std::invalid_argument&) {
+            raised = true;
+        }
+        if (!raised)
+            throw std::logic_error("CSVLazyData doesn't check rows and columns.");
+    }
+
+    std::ofstream(path, std::ios::trunc);
+    csvm::CSVLazyData empty(path);
+    if (empty.row_number() != 0 || empty.column_number() != 0)
+        throw std::logic_error("CSVLazyData doesn't handle empty files.");
+
+    std::filesystem::remove(path);
+}
+
+
+int main() {
+
+    test_same_as_reader();
+
+    test_quoted_rows();
+
+    test_errors();
+
+    return 0;
+}
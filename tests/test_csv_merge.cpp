@@ -0,0 +1,87 @@
+// Tests for csv_merge.hpp.
+
+
+#include <iostream>
+#include <filesystem>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+
+#include "../csv_merge.hpp"
+
+
+using vector_s = std::vector<std::string>;
+using vector_v_s = std::vector<vector_s>;
+
+
+std::string file_path = __FILE__;
+std::string current_dir = file_path.substr(0, file_path.find_last_of("/\\"));
+std::string output_path = current_dir + "/assets/merged_1.csv";
+
+
+std::string write_shard(int number, const vector_v_s& rows, const vector_s& columns = {"key", "shard"}) {
+    // Writes one shard and returns its path.
+    csvm::CSVData data;
+    for (auto& i : columns)
+        data.add_column(i);
+    for (auto& i : rows)
+        data.add_row(i);
+
+    std::string path = current_dir + "/assets/shard_" + std::to_string(number) + ".csv";
+    csvm::CSVWriter(data, path).write_all();
+    return path;
+}
+
+
+void test_merge() {
+    // Sorted shards should be merged into one sorted file, and equal keys should keep the order of shards.
+    vector_s paths = {
+        write_shard(0, {{"a", "0"}, {"c", "0"}, {"c", "0"}, {"f", "0"}}),
+        write_shard(1, {}),
+        write_shard(2, {{"b", "2"}, {"c", "2"}, {"g", "2"}}),
+        write_shard(3, {{"a", "3"}, {"z", "3"}})
+    };
+
+    csvm::CSVMerger(paths, output_path, {"key"}, ",", '"', 2).merge();
+
+    csvm::CSVData output;
+    csvm::CSVReader(output, output_path).read_all();
+
+    vector_v_s target = {{"a", "0"}, {"a", "3"}, {"b", "2"}, {"c", "0"}, {"c", "0"}, {"c", "2"}, {"f", "0"}, {"g", "2"}, {"z", "3"}};
+
+    for (auto& i : paths)
+        std::filesystem::remove(i);
+
+    if (output.get_column_names() != vector_s{"key", "shard"} || output.get_values() != target)
+        throw std::logic_error("CSVMerger doesn't merge sorted files properly.");
+}
+
+
+void test_invalid_input() {
+    // Shards with different columns and non-existing keys should be rejected.
+    vector_s paths = {write_shard(0, {{"a", "0"}}), write_shard(1, {{"a", "1"}}, {"key", "other"})};
+
+    bool bad = false;
+    try {csvm::CSVMerger(paths, output_path, {"key"}).merge(); bad = true;} catch (std::invalid_argument) {}
+    try {csvm::CSVMerger({paths[0]}, output_path, {"missing"}).merge(); bad = true;} catch (std::invalid_argument) {}
+    try {csvm::CSVMerger({current_dir + "/assets/missing.csv"}, output_path, {"key"}).merge(); bad = true;} catch (std::runtime_error) {}
+
+    for (auto& i : paths)
+        std::filesystem::remove(i);
+
+    if (bad)
+        throw std::logic_error("CSVMerger doesn't reject invalid inputs.");
+}
+
+
+int main() {
+
+    test_merge();
+
+    test_invalid_input();
+
+    std::filesystem::remove(output_path);
+
+    return 0;
+}
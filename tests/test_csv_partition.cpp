@@ -0,0 +1,144 @@
+// Tests for csv_partition.hpp.
+
+
+#include <iostream>
+#include <filesystem>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+#include "../csv_partition.hpp"
+#include "../csv_reader.hpp"
+
+
+using vector_s = std::vector<std::string>;
+using vector_v_s = std::vector<vector_s>;
+
+
+std::string file_path = __FILE__;
+std::string current_dir = file_path.substr(0, file_path.find_last_of("/\\"));
+std::string output_dir = current_dir + "/assets/partitions";
+
+
+csvm::CSVData make_data(int rows) {
+    // Creates data with a key column, a partition column and a text column.
+    csvm::CSVData data;
+    data.add_column("key").add_column("day").add_column("text");
+    for (int i = 0; i < rows; ++i)
+        data.add_row({std::to_string(i % 37), i % 3 ? "2024-01-0" + std::to_string(i % 3) : "a/b", i % 4 ? "plain" : "with,comma"});
+    return data;
+}
+
+
+csvm::CSVData read_all(const vector_s& paths) {
+    // Reads all files into one CSVData.
+    csvm::CSVData output, part;
+    for (auto& i : paths) {
+        csvm::CSVReader(part, i).read_all();
+        if (output.column_number() == 0)
+            output.get_column_index() = part.get_column_index();
+        for (auto& row : part)
+            output.add_row(row);
+    }
+    return output;
+}
+
+
+void test_hashed() {
+    // Every key should go into exactly one file, and all rows should be written.
+    auto data = make_data(1000);
+    auto paths = csvm::CSVPartitionWriter(data, output_dir, ",", '"', 4).write_hashed("key", 8);
+
+    if (paths.size() != 8 || paths[3] != output_dir + "/part-00003.csv")
+        throw std::logic_error("Hashed partitions have wrong paths.");
+
+    std::map<std::string, std::string> files;
+    for (auto& i : paths) {
+        csvm::CSVData part;
+        csvm::CSVReader(part, i).read_all();
+        if (part.get_column_names() != data.get_column_names())
+            throw std::logic_error("A hashed partition has a wrong header.");
+
+        for (auto& row : part)
+            if (files.try_emplace(row[0], i).first->second != i)
+                throw std::logic_error("A key is written into two hashed partitions.");
+    }
+
+    auto output = read_all(paths);
+    std::filesystem::remove_all(output_dir);
+
+    auto sorted = [](csvm::CSVData& d) {
+        vector_v_s rows(d.begin(), d.end());
+        std::sort(rows.begin(), rows.end());
+        return rows;
+    };
+    if (sorted(output) != sorted(data))
+        throw std::logic_error("Hashed partitions don't contain all rows.");
+
+    try {
+        csvm::CSVPartitionWriter(data, output_dir).write_hashed("nothing", 2);
+        throw std::logic_error("A missing key column isn't detected.");
+    }
+    catch (std::invalid_argument&) {}
+}
+
+
+void test_by_value() {
+    // Rows should be put into Hive-style directories by their value, without the partition column.
+    auto data = make_data(100);
+    auto paths = csvm::CSVPartitionWriter(data, output_dir).write_by_value("day");
+
+    vector_s correct = {output_dir + "/day=a%2Fb/part-00000.csv", output_dir + "/day=2024-01-01/part-00000.csv",
+                        output_dir + "/day=2024-01-02/part-00000.csv"};
+    if (paths != correct)
+        throw std::logic_error("Value partitions have wrong paths.");
+
+    csvm::CSVData part;
+    csvm::CSVReader(part, paths[1]).read_all();
+    std::filesystem::remove_all(output_dir);
+
+    if (part.get_column_names() != vector_s{"key", "text"} || part.row_number() != 33 || part.get_values()[0] != vector_s{"1", "plain"})
+        throw std::logic_error("A value partition has wrong content.");
+}
+
+
+void test_split() {
+    // Files should respect limits of rows and bytes and keep the order of rows.
+    auto data = make_data(1000);
+
+    auto paths = csvm::CSVPartitionWriter(data, output_dir).write_split(300);
+    auto output = read_all(paths);
+    if (paths.size() != 4 || output != data)
+        throw std::logic_error("Splitting by rows doesn't work right.");
+    std::filesystem::remove_all(output_dir);
+
+    paths = csvm::CSVPartitionWriter(data, output_dir, ",", '"', 3).write_split(0, 2000);
+    for (auto& i : paths)
+        if (std::filesystem::file_size(i) > 2000)
+            throw std::logic_error("A file is bigger than the byte limit.");
+    output = read_all(paths);
+    std::filesystem::remove_all(output_dir);
+
+    if (paths.size() < 10 || output != data)
+        throw std::logic_error("Splitting by bytes doesn't work right.");
+
+    try {
+        csvm::CSVPartitionWriter(data, output_dir).write_split(0, 0);
+        throw std::logic_error("Splitting without limits isn't detected.");
+    }
+    catch (std::invalid_argument&) {}
+}
+
+
+int main() {
+
+    test_hashed();
+
+    test_by_value();
+
+    test_split();
+
+    return 0;
+}
@@ -0,0 +1,226 @@
+// Tests for csv_pipeline.hpp
+
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <filesystem>
+#include <thread>
+#include <chrono>
+#include <ctime>
+
+#include "../csv_pipeline.hpp"
+#include "../csv_reader.hpp"
+#include "../csv_writer.hpp"
+
+
+using vector_s = std::vector<std::string>;
+using vector_v_s = std::vector<vector_s>;
+
+
+std::string file_path = __FILE__;
+std::string current_dir = file_path.substr(0, file_path.find_last_of("/\\"));
+
+
+void write_input(const std::string& path, std::size_t rows) {
+    // Writes a file with the columns Id, Name and Score.
+    csvm::CSVData data;
+    data.add_column("Id").add_column("Name").add_column("Score");
+    for (std::size_t i = 0; i < rows; ++i)
+        data.add_row({std::to_string(i), i % 5 ? "name " + std::to_string(i) : "a \"quoted\", name", std::to_string(i % 100)});
+    csvm::CSVWriter(data, path).write_all();
+}
+
+
+void test_ring_queue() {
+    // Values should go from the producer to the consumer in their order, and the queue should report when it's full or empty.
+    csvm::CSVRingQueue<int> queue(2);
+    int value = 1;
+    if (!queue.try_push(value) || !queue.try_push(value) || queue.try_push(value))
+        throw std::logic_error("CSVRingQueue doesn't keep its capacity.");
+    if (!queue.try_pop(value) || !queue.try_pop(value) || queue.try_pop(value))
+        throw std::logic_error("CSVRingQueue doesn't report when it's empty.");
+
+    csvm::CSVRingQueue<std::size_t> numbers(16);
+    std::size_t count = 200000;
+    std::thread producer([&numbers, count]() {
+        for (std::size_t i = 0; i < count; ++i)
+            while (!numbers.try_push(i))
+                std::this_thread::yield();
+    });
+
+    bool ordered = true;
+    for (std::size_t i = 0, got; i < count;) {
+        if (numbers.try_pop(got))
+            ordered = ordered && got == i++;
+        else
+            std::this_thread::yield();
+    }
+    producer.join();
+
+    if (!ordered)
+        throw std::logic_error("CSVRingQueue doesn't keep the order of values.");
+}
+
+
+void test_write() {
+    // Filtered, changed and projected rows should be written in their order, with and without threads.
+    std::string input = current_dir + "/assets/pipeline_1.csv", output = current_dir + "/assets/pipeline_2.csv";
+    write_input(input, 10000);
+
+    csvm::CSVData data;
+    csvm::CSVReader(data, input).read_all();
+    csvm::CSVData target;
+    target.add_column("Score").add_column("Name");
+    for (auto& i : data.get_values())
+        if (std::stoi(i[2]) >= 50)
+            target.add_row({i[2], "<" + i[1] + ">"});
+
+    for (bool threaded : {true, false})
+        for (std::size_t batch_rows : {1, 7, 4096}) {
+            csvm::CSVPipeline pipeline(input, ",", '"', batch_rows, 3);
+            pipeline.filter([](const vector_s& row) {return std::stoi(row[2]) >= 50;})
+                    .map([](vector_s& row) {row[1] = "<" + row[1] + ">";})
+                    .project({"Score", "Name"});
+
+            if (pipeline.get_column_names() != vector_s{"Score", "Name"})
+                throw std::logic_error("CSVPipeline::project() doesn't change columns.");
+            if (pipeline.write(output, ";", '\'', threaded) != target.get_values().size())
+                throw std::logic_error("CSVPipeline::write() doesn't return the number of rows.");
+
+            csvm::CSVData result;
+            csvm::CSVReader(result, output, ";", '\'').read_all();
+            if (result != target)
+                throw std::logic_error("CSVPipeline doesn't write the transformed rows.");
+        }
+
+    std::filesystem::remove(input);
+    std::filesystem::remove(output);
+}
+
+
+void test_for_each() {
+    // Every row should reach the sink once, and a pipeline without stages should pass rows as they are.
+    std::string input = current_dir + "/assets/pipeline_3.csv";
+    write_input(input, 1000);
+
+    std::size_t sum = 0;
+    auto number = csvm::CSVPipeline(input, ",", '"', 10).for_each([&sum](vector_s& row) {sum += std::stoul(row[0]);});
+    if (number != 1000 || sum != 999 * 1000 / 2)
+        throw std::logic_error("CSVPipeline::for_each() doesn't pass every row.");
+
+    std::filesystem::remove(input);
+}
+
+
+void test_errors() {
+    // Exceptions of stages and sinks should stop the run and be rethrown. Wrong columns and second runs should raise exceptions.
+    std::string input = current_dir + "/assets/pipeline_4.csv";
+    write_input(input, 5000);
+
+    for (bool threaded : {true, false}) {
+        bool raised = false;
+        try {
+            csvm::CSVPipeline(input, ",", '"', 16).map([](vector_s& row) {
+                if (row[0] == "3000")
+                    throw std::range_error("Stage failed.");
+            }).for_each([](vector_s&) {}, threaded);
+        }
+        catch (const std::range_error&) {
+            raised = true;
+        }
+        if (!raised)
+            throw std::logic_error("CSVPipeline doesn't rethrow exceptions of stages.");
+
+        raised = false;
+        try {
+            csvm::CSVPipeline(input, ",", '"', 16).for_each([](vector_s& row) {
+                if (row[0] == "100")
+                    throw std::range_error("Sink failed.");
+            }, threaded);
+        }
+        catch (const std::range_error&) {
+            raised = true;
+        }
+        if (!raised)
+            throw std::logic_error("CSVPipeline doesn't rethrow exceptions of sinks.");
+    }
+
+    csvm::CSVPipeline pipeline(input);
+    for (vector_s columns : {vector_s{"Nothing"}, vector_s{"Id", "Id"}}) {
+        bool raised = false;
+        try {
+            pipeline.project(columns);
+        }
+        catch (const std::invalid_argument&) {
+            raised = true;
+        }
+        if (!raised)
+            throw std::logic_error("CSVPipeline::project() doesn't check columns.");
+    }
+
+    pipeline.for_each([](vector_s&) {});
+    bool raised = false;
+    try {
+        pipeline.for_each([](vector_s&) {});
+    }
+    catch (const std::runtime_error&) {
+        raised = true;
+    }
+    if (!raised)
+        throw std::logic_error("CSVPipeline runs twice.");
+
+    std::filesystem::remove(input);
+}
+
+
+void test_sleeping_threads() {
+    // Threads which wait for a slow sink should sleep instead of using CPU, and be woken when the sink fails.
+    std::string input = current_dir + "/assets/pipeline_5.csv";
+    write_input(input, 200);
+
+    auto cpu_begin = std::clock();
+    auto wall_begin = std::chrono::steady_clock::now();
+    auto number = csvm::CSVPipeline(input, ",", '"', 16, 2).map([](vector_s&) {}).map([](vector_s&) {}).map([](vector_s&) {})
+                  .for_each_batch([](vector_v_s&) {std::this_thread::sleep_for(std::chrono::milliseconds(20));});
+    double cpu = static_cast<double>(std::clock() - cpu_begin) / CLOCKS_PER_SEC;
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_begin).count();
+
+    if (number != 200 || cpu > wall / 2)
+        throw std::logic_error("Threads of CSVPipeline use CPU while they wait: " + std::to_string(cpu) + " s of " + std::to_string(wall) + " s.");
+
+    bool raised = false;
+    try {
+        int batches = 0;
+        csvm::CSVPipeline(input, ",", '"', 16, 2).map([](vector_s&) {}).for_each_batch([&batches](vector_v_s&) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            if (++batches == 3)
+                throw std::range_error("Sink failed.");
+        });
+    }
+    catch (const std::range_error&) {
+        raised = true;
+    }
+    if (!raised)
+        throw std::logic_error("CSVPipeline doesn't stop sleeping threads on errors.");
+
+    std::filesystem::remove(input);
+}
+
+
+int main() {
+
+    test_ring_queue();
+
+    test_write();
+
+    test_for_each();
+
+    test_errors();
+
+    test_sleeping_threads();
+
+    return 0;
+}
@@ -5,6 +5,7 @@
 #include <stdexcept>
 #include <filesystem>
 #include <string>
+#include <fstream>
 
 #include "../csv_reader.hpp"
 #include "../csv_parser.hpp"
@@ -166,6 +167,123 @@ void test_fixed_columns() {
 }
 
 
+void test_read_batch() {
+    // Batches should hold consecutive rows and reuse their storage.
+    csvm::CSVData output, batch;
+    csvm::CSVReader reader(output, current_dir + "/assets/file_4.csv", "|");
+
+    if (reader.read_batch(batch, 3) != 3 || batch.get_column_index() != output.get_column_index() ||
+        batch.get_values() != vector_v_s{{"Roxie", "Marcellus", ""}, {"Faith", "", ""}, {"Nina", "Christa", "Haddan"}})
+        throw std::logic_error("CSVReader doesn't read the first batch properly.");
+
+    auto storage = batch.get_values().data();
+
+    if (reader.read_batch(batch, 3) != 1 || batch.get_values() != vector_v_s{{"Remedios", "Claretha", "Haddan"}})
+        throw std::logic_error("CSVReader doesn't read the last batch properly.");
+
+    if (batch.get_values().data() != storage)
+        throw std::logic_error("CSVReader doesn't reuse the storage of the batch.");
+
+    if (reader.read_batch(batch, 3) != 0 || batch.row_number() != 0 || output.row_number() != 0)
+        throw std::logic_error("CSVReader reads batches after the end of the file.");
+}
+
+
+void test_row_index() {
+    // .seek_row() should read the same rows as .read_all(), with and without the index, including rows of many lines.
+    std::string path = current_dir + "/assets/indexed.csv", index_path = path + ".idx";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "Id,Text\r\n";
+        for (int i = 0; i < 100; ++i)
+            file << i << (i % 3 ? ",plain\r\n" : ",\"two\nlines, \"\"quoted\"\"\"\n");
+    }
+
+    csvm::CSVData all;
+    csvm::CSVReader(all, path).build_index(7).read_all();
+    if (!std::filesystem::exists(index_path))
+        throw std::logic_error("CSVReader doesn't write the index.");
+
+    for (int pass = 0; pass < 2; ++pass) {
+        for (std::size_t number : {0, 1, 6, 7, 8, 50, 98, 99}) {
+            csvm::CSVData output;
+            csvm::CSVReader(output, path).seek_row(number).read_line();
+            if (output.get_values() != vector_v_s{all.get_values()[number]})
+                throw std::logic_error("CSVReader::seek_row() doesn't find the row " + std::to_string(number) + ".");
+        }
+
+        bool raised = false;
+        try {
+            csvm::CSVData output;
+            csvm::CSVReader(output, path).seek_row(100);
+        }
+        catch (const std::out_of_range&) {
+            raised = true;
+        }
+        if (!raised)
+            throw std::logic_error("CSVReader::seek_row() doesn't check the number of rows.");
+
+        // The second pass works without the index.
+        std::filesystem::remove(index_path);
+    }
+
+    // Reading goes on from the found row, and the index isn't used for another separator.
+    csvm::CSVReader(all, path).build_index(10).read_all();
+    csvm::CSVData output;
+    csvm::CSVReader reader(output, path);
+    reader.seek_row(95).read_all();
+    if (output.get_values() != vector_v_s(all.get_values().begin() + 95, all.get_values().end()))
+        throw std::logic_error("CSVReader doesn't read rows after the found one.");
+
+    bool raised = false;
+    try {
+        reader.build_index();
+    }
+    catch (const std::runtime_error&) {
+        raised = true;
+    }
+    if (!raised)
+        throw std::logic_error("CSVReader builds the index after reading rows.");
+
+    csvm::CSVData other, other_all;
+    csvm::CSVReader(other_all, path, ";").read_all();
+    csvm::CSVReader(other, path, ";").seek_row(3).read_line();
+    if (other.get_values() != vector_v_s{other_all.get_values()[3]})
+        throw std::logic_error("CSVReader uses the index of another separator.");
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(index_path);
+}
+
+
+void test_reserve_rows() {
+    // .read_all() should reserve rows from the size of the file, and read the same rows as .read_line().
+    std::string path = current_dir + "/assets/reserve.csv";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "Id|Text|Other\n";
+        for (int i = 10000; i < 15000; ++i)
+            file << i << (i % 5 ? "|text|" : "|\"a|b\"|") << std::string(i % 3 ? 0 : 10, 'x') << "\n";
+    }
+
+    csvm::CSVData output, target;
+    csvm::CSVReader(output, path, "|").read_all();
+    csvm::CSVReader reader(target, path, "|");
+    for (int i = 0; i < 5000; ++i)
+        reader.read_line();
+
+    if (output != target || output.row_number() != 5000 || output[4][1] != "text" || output[5][1] != "a|b" || output[2][2] != "xxxxxxxxxx")
+        throw std::logic_error("CSVReader::read_all() doesn't read all rows.");
+
+    // Without the estimate, the vector of rows would grow to 8192 rows.
+    auto capacity = output.get_values().capacity();
+    if (capacity < 5000 || capacity > 6000)
+        throw std::logic_error("CSVReader::read_all() doesn't reserve rows for the file: " + std::to_string(capacity));
+
+    std::filesystem::remove(path);
+}
+
+
 int main() {
 
     test_extract_header();
@@ -186,5 +304,11 @@ int main() {
 
     test_fixed_columns();
 
+    test_read_batch();
+
+    test_row_index();
+
+    test_reserve_rows();
+
     return 0;
 }
@@ -0,0 +1,113 @@
+// Tests for csv_scanner.hpp
+
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <filesystem>
+
+#include "../csv_scanner.hpp"
+#include "../csv_lazy_data.hpp"
+#include "../csv_reader.hpp"
+
+
+std::string file_path = __FILE__;
+std::string current_dir = file_path.substr(0, file_path.find_last_of("/\\"));
+
+
+void test_scanner() {
+    // The scanner should find the first character from the set at any position.
+    csvm::CSVScanner scanner(",\"\n,");
+    for (std::size_t size = 0; size < 70; ++size)
+        for (std::size_t position = 0; position <= size; ++position) {
+            std::string text(size, 'a');
+            if (position < size)
+                text[position] = position % 2 ? '\n' : '"';
+            const char* found = scanner.find(text.data(), text.data() + text.size());
+            if (found != text.data() + position)
+                throw std::logic_error("CSVScanner doesn't find characters.");
+        }
+    if (!scanner.contains(',') || scanner.contains('a'))
+        throw std::logic_error("CSVScanner::contains() doesn't work right.");
+}
+
+
+void test_count_rows() {
+    // Line feeds inside quoted fields shouldn't be counted, at any position of blocks.
+    csvm::CSVCounter counter;
+    for (std::size_t padding = 0; padding < 40; ++padding) {
+        std::string text = std::string(padding, 'x') + ",\"a\nb\"\"\n\",c\n" + std::string(padding, 'y') + ",\"d\n\"\nq\"r\ns\n\n\"open\nend";
+        if (counter.count_rows(text.data(), text.size()) != 6)
+            throw std::logic_error("CSVCounter doesn't count rows with quoted line feeds.");
+    }
+
+    std::string text = "a\nb\nc";
+    if (counter.count_rows(text.data(), 0) != 0 || counter.count_rows(text.data(), 2) != 1 || counter.count_rows(text.data(), 5) != 3)
+        throw std::logic_error("CSVCounter doesn't count rows without the last line feed.");
+}
+
+
+void test_scan_stats() {
+    // Statistics should describe rows without line ends, and fields split by the delimiter outside quotes.
+    std::string text = "A<|>B<|>C\r\n1<|>\"x<|>\ny\"<|>3\n\n<|>\"q\"\"\"";
+    auto stats = csvm::CSVCounter("<|>").scan_stats(text.data(), text.size());
+
+    if (stats.rows != 4 || stats.max_fields != 3 || stats.multiline_rows != 1 || stats.max_row_size != 16 ||
+        stats.total_row_size != 9 + 16 + 0 + 8 || stats.average_row_size() != 33.0 / 4)
+        throw std::logic_error("CSVCounter::scan_stats() doesn't collect statistics.");
+}
+
+
+void test_same_as_lazy_data() {
+    // Files should have as many rows as CSVLazyData finds, with the header.
+    std::string path = current_dir + "/assets/counter.csv";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "Id,Text\n";
+        for (int i = 0; i < 1000; ++i)
+            file << i << (i % 7 ? ",\"plain \"\"text\"\"\"\n" : ",\"many\nlines\r\nhere\"\r\n");
+    }
+
+    csvm::CSVCounter counter;
+    auto stats = counter.scan_stats(path);
+    if (counter.count_rows(path) != 1001 || stats.rows != 1001 || csvm::CSVLazyData(path).row_number() != 1000)
+        throw std::logic_error("CSVCounter doesn't count rows of files.");
+
+    // Data rows should be as many as CSVReader reads.
+    csvm::CSVData data;
+    csvm::CSVReader(data, path).read_all();
+    if (counter.count_data_rows(path) != 1000 || data.row_number() != 1000)
+        throw std::logic_error("CSVCounter doesn't count data rows like CSVReader.");
+    if (stats.multiline_rows != 143 || stats.max_fields != 2)
+        throw std::logic_error("CSVCounter doesn't collect statistics of files.");
+
+    std::filesystem::remove(path);
+}
+
+
+void test_count_data_rows() {
+    // The header shouldn't be counted, and text without rows should have none.
+    csvm::CSVCounter counter;
+    std::string text = "A,B\n1,\"x\ny\"\n2,z";
+    if (counter.count_data_rows(text.data(), text.size()) != 2 || counter.count_data_rows(text.data(), 4) != 0 ||
+        counter.count_data_rows(text.data(), 0) != 0)
+        throw std::logic_error("CSVCounter::count_data_rows() counts the header.");
+}
+
+
+int main() {
+
+    test_scanner();
+
+    test_count_rows();
+
+    test_scan_stats();
+
+    test_count_data_rows();
+
+    test_same_as_lazy_data();
+
+    return 0;
+}
@@ -0,0 +1,194 @@
+// Tests for csv_sink.hpp.
+
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <vector>
+#include <string>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../csv_sink.hpp"
+#include "../csv_encoder.hpp"
+
+
+using vector_s = std::vector<std::string>;
+using vector_v_s = std::vector<vector_s>;
+
+
+std::string file_path = __FILE__;
+std::string current_dir = file_path.substr(0, file_path.find_last_of("/\\"));
+
+vector_v_s source = {{"first", "se,cond"}, {"\"third\"", ""}, {std::string(40, 'x'), "end"}};
+std::string target = "first,\"se,cond\"\n\"\"\"third\"\"\",\n" + std::string(40, 'x') + ",end\n";
+
+
+void test_buffer_sink() {
+    // All rows should be appended to the buffer.
+    csvm::CSVBufferSink sink;
+    csvm::CSVEncoder<vector_v_s::iterator>(source.begin(), source.end()).encode_all(sink);
+
+    if (sink.buffer != target)
+        throw std::logic_error("CSVBufferSink doesn't collect encoded rows properly.");
+
+    sink.clear();
+    csvm::CSVEncoder<vector_v_s::iterator>(source.begin(), source.begin() + 1).encode_all(sink, "\r\n");
+
+    if (sink.buffer != "first,\"se,cond\"\r\n")
+        throw std::logic_error("CSVEncoder::encode_all() doesn't use the given line end.");
+}
+
+
+void test_callback_sink() {
+    // The callback should get all bytes in order, in pieces not smaller than the buffer unless they are the last.
+    char buffer[16];
+    vector_s pieces;
+    csvm::CSVCallbackSink sink(buffer, sizeof(buffer), [&pieces](const char* data, std::size_t size) {pieces.emplace_back(data, size);});
+
+    csvm::CSVEncoder<vector_v_s::iterator>(source.begin(), source.end()).encode_all(sink);
+    sink.flush().flush();
+
+    std::string output;
+    for (auto& i : pieces)
+        output += i;
+
+    if (output != target || pieces.size() < 3)
+        throw std::logic_error("CSVCallbackSink doesn't pass bytes properly.");
+}
+
+
+void test_memory_sink() {
+    // Bytes should be written into the range, and overflows should be detected.
+    std::string memory(target.size(), ' ');
+    csvm::CSVMemorySink sink(memory.data(), memory.size());
+    csvm::CSVEncoder<vector_v_s::iterator> encoder(source.begin(), source.end());
+    encoder.encode_all(sink);
+
+    if (memory != target || sink.size() != target.size() || encoder.encoded_size() != target.size())
+        throw std::logic_error("CSVMemorySink doesn't write bytes properly.");
+
+    try {
+        sink.write("x", 1);
+        throw std::logic_error("CSVMemorySink doesn't detect overflows.");
+    }
+    catch (std::length_error&) {}
+}
+
+
+void test_file_sink() {
+    // Everything should be written into the file when the sink is destroyed.
+    std::string path = current_dir + "/assets/written_3.csv";
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    {
+        csvm::CSVFileSink sink(fd, 8);
+        csvm::CSVEncoder<vector_v_s::iterator>(source.begin(), source.end()).encode_all(sink);
+    }
+    ::close(fd);
+
+    std::stringstream output;
+    output << std::ifstream(path).rdbuf();
+    std::filesystem::remove(path);
+
+    if (output.str() != target)
+        throw std::logic_error("CSVFileSink doesn't write bytes properly.");
+}
+
+
+void test_file_sink_stats() {
+    // Pieces bigger than the buffer should be written with the buffered bytes in one call, and syncs should follow the policy.
+    std::string path = current_dir + "/assets/written_3.csv";
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    std::string big(100, 'b');
+
+    csvm::CSVFileSink sink(fd, 16, csvm::CSVFileSink::Sync::on_close);
+    sink.write("abc", 3);
+    sink.write(big.data(), big.size());
+    sink.write("def", 3);
+
+    if (sink.stats().bytes != 103 || sink.stats().syscalls != 1 || sink.stats().syncs != 0)
+        throw std::logic_error("CSVFileSink doesn't write big pieces together with the buffer.");
+
+    sink.close();
+    if (sink.stats().bytes != 106 || sink.stats().syscalls != 2 || sink.stats().syncs != 1)
+        throw std::logic_error("CSVFileSink doesn't sync on close.");
+    ::close(fd);
+
+    std::stringstream output;
+    output << std::ifstream(path).rdbuf();
+    if (output.str() != "abc" + big + "def")
+        throw std::logic_error("CSVFileSink doesn't write bytes properly with writev.");
+
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    {
+        csvm::CSVFileSink periodic(fd, 8, csvm::CSVFileSink::Sync::periodic, 20);
+        for (int i = 0; i < 10; ++i)
+            periodic.write("12345678", 8);
+        if (periodic.stats().bytes != 80 || periodic.stats().syncs != 2)
+            throw std::logic_error("CSVFileSink doesn't sync periodically.");
+
+        csvm::CSVFileSink never(fd, 8);
+        never.write(big.data(), big.size());
+        never.close();
+        if (never.stats().syncs != 0)
+            throw std::logic_error("CSVFileSink syncs with the never policy.");
+    }
+    ::close(fd);
+    std::filesystem::remove(path);
+}
+
+
+void test_async_sink() {
+    // The background thread should pass all bytes to the target in order, and errors of the target should be rethrown.
+    char buffer[4];
+    std::string output;
+    csvm::CSVCallbackSink callback(buffer, sizeof(buffer), [&output](const char* data, std::size_t size) {output.append(data, size);});
+
+    {
+        csvm::CSVAsyncSink<csvm::CSVCallbackSink> sink(callback, 8, 3);
+        for (int i = 0; i < 100; ++i)
+            csvm::CSVEncoder<vector_v_s::iterator>(source.begin(), source.end()).encode_all(sink);
+        sink.wait();
+
+        std::string correct;
+        for (int i = 0; i < 100; ++i)
+            correct += target;
+        if (output != correct)
+            throw std::logic_error("CSVAsyncSink doesn't pass bytes properly.");
+
+        csvm::CSVEncoder<vector_v_s::iterator>(source.begin(), source.end()).encode_all(sink);
+    }
+    if (output.size() != target.size() * 101)
+        throw std::logic_error("CSVAsyncSink doesn't write everything on destruction.");
+
+    csvm::CSVCallbackSink failing(buffer, sizeof(buffer), [](const char*, std::size_t) {throw std::runtime_error("failed");});
+    csvm::CSVAsyncSink<csvm::CSVCallbackSink> sink(failing, 8);
+    try {
+        sink.write("0123456789", 10);
+        sink.wait();
+        throw std::logic_error("CSVAsyncSink doesn't rethrow errors of the target.");
+    }
+    catch (std::runtime_error&) {}
+}
+
+
+int main() {
+
+    test_buffer_sink();
+
+    test_callback_sink();
+
+    test_memory_sink();
+
+    test_file_sink();
+
+    test_file_sink_stats();
+
+    test_async_sink();
+
+    return 0;
+}
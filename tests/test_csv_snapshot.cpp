@@ -0,0 +1,126 @@
+// Tests for csv_snapshot.hpp.
+
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include "../csv_snapshot.hpp"
+
+
+using vector_s = std::vector<std::string>;
+using vector_v_s = std::vector<vector_s>;
+
+
+std::string file_path = __FILE__;
+std::string current_dir = file_path.substr(0, file_path.find_last_of("/\\"));
+std::string snapshot_path = current_dir + "/assets/snapshot_2.bin";
+
+
+void test_lazy_access() {
+    // Fields and columns of a written snapshot should be accessible without loading.
+    vector_s columns = {"first", "second"};
+    vector_v_s values = {{"a", "bb"}, {"", "ccc\r\nd"}, {"e", ""}};
+
+    csvm::CSVSnapshot::write(snapshot_path, columns, values);
+    csvm::CSVSnapshot snapshot(snapshot_path);
+
+    if (snapshot.row_number() != 3 || snapshot.column_number() != 2 || snapshot.get_column_names() != columns)
+        throw std::logic_error("CSVSnapshot doesn't read the schema properly.");
+
+    if (snapshot.field(1, 1) != "ccc\r\nd" || snapshot.field(1, 0) != "" || snapshot[2] != values[2])
+        throw std::logic_error("CSVSnapshot doesn't read fields properly.");
+
+    bool bad = false;
+    try {snapshot.field(3, 0); bad = true;} catch (std::invalid_argument) {}
+    try {snapshot.field(0, 2); bad = true;} catch (std::invalid_argument) {}
+
+    if (bad)
+        throw std::logic_error("CSVSnapshot doesn't prohibit access to non-existing fields.");
+}
+
+
+void test_empty_snapshot() {
+    // A snapshot without columns and rows should be valid.
+    csvm::CSVSnapshot::write(snapshot_path, {}, {});
+    csvm::CSVSnapshot snapshot(snapshot_path);
+
+    if (snapshot.row_number() != 0 || snapshot.column_number() != 0)
+        throw std::logic_error("An empty snapshot isn't empty.");
+
+    // A header with rows but without columns should be rejected, so loading doesn't allocate any number of rows.
+    {
+        std::fstream file(snapshot_path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(offsetof(csvm::CSVSnapshot::Header, row_number));
+        csvm::CSVSnapshot::size_type rows = std::uint64_t(1) << 60;
+        file.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+    }
+
+    bool bad = false;
+    try {csvm::CSVSnapshot broken(snapshot_path); bad = true;} catch (std::runtime_error) {}
+    if (bad)
+        throw std::logic_error("CSVSnapshot accepts rows without columns.");
+}
+
+
+void test_broken_snapshot() {
+    // Damaged snapshots should be detected.
+    csvm::CSVSnapshot::write(snapshot_path, {"column"}, {{"value"}});
+
+    {
+        std::fstream file(snapshot_path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(-1, std::ios::end);
+        file.put('X');
+    }
+
+    bool bad = false;
+    try {csvm::CSVSnapshot snapshot(snapshot_path, true); bad = true;} catch (std::runtime_error) {}
+    try {csvm::CSVSnapshot snapshot(current_dir + "/assets/file_3.csv"); bad = true;} catch (std::runtime_error) {}
+
+    if (bad)
+        throw std::logic_error("CSVSnapshot doesn't detect broken snapshots.");
+
+    // Without verification, which is the default, the damaged field is just read as is, and the checksum can be checked later.
+    csvm::CSVSnapshot snapshot(snapshot_path);
+    if (snapshot.field(0, 0) != "valuX" || snapshot.is_checksum_valid())
+        throw std::logic_error("CSVSnapshot without verification doesn't read fields.");
+}
+
+
+void test_binary_data() {
+    // Data saved by save_binary() should be loaded back by load_binary() without changes.
+    std::string path = current_dir + "/assets/snapshot_1.bin";
+
+    csvm::CSVData data, output;
+    data.add_column("Name").add_column("Quote").add_column("Empty");
+    data.add_row({{"Grag", "\"32\"\n", ""}, {"Jane", "", "x"}});
+    csvm::save_binary(data, path);
+
+    output.add_column("Something").add_row({"old"});
+    csvm::load_binary(output, path, true);
+    std::filesystem::remove(path);
+
+    if (output != data || output.get_column_names() != data.get_column_names())
+        throw std::logic_error("load_binary() doesn't restore data saved by save_binary().");
+}
+
+
+int main() {
+
+    test_lazy_access();
+
+    test_empty_snapshot();
+
+    test_broken_snapshot();
+
+    test_binary_data();
+
+    std::filesystem::remove(snapshot_path);
+
+    return 0;
+}
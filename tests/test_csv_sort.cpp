@@ -0,0 +1,98 @@
+// Tests for csv_sort.hpp.
+
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+
+#include "../csv_sort.hpp"
+
+
+using vector_s = std::vector<std::string>;
+using vector_v_s = std::vector<vector_s>;
+
+
+std::string file_path = __FILE__;
+std::string current_dir = file_path.substr(0, file_path.find_last_of("/\\"));
+std::string input_path = current_dir + "/assets/unsorted_1.csv";
+std::string output_path = current_dir + "/assets/sorted_1.csv";
+
+
+csvm::CSVData make_input(int rows) {
+    // Writes the input file with pseudo-random keys, quoted fields, and the number of every row.
+    csvm::CSVData data;
+    data.add_column("key").add_column("number").add_column("text");
+
+    unsigned seed = 7;
+    for (int i = 0; i < rows; ++i) {
+        seed = seed * 1103515245 + 12345;
+        data.add_row({std::to_string(seed % 100), std::to_string(i), i % 5 ? "plain" : "with|sep and \"quote"});
+    }
+
+    csvm::CSVWriter(data, input_path, "|").write_all();
+    return data;
+}
+
+
+void check_sorted(csvm::CSVData& input, const std::string& message) {
+    // Compares the output file with the stable sort of the input.
+    csvm::CSVData output;
+    csvm::CSVReader(output, output_path, "|").read_all();
+
+    auto target = input.get_values();
+    std::stable_sort(target.begin(), target.end(), [](const vector_s& left, const vector_s& right) {return left[0] < right[0];});
+
+    if (output.get_column_names() != input.get_column_names() || output.get_values() != target)
+        throw std::logic_error(message);
+}
+
+
+void test_sort_in_memory() {
+    // A small file should be sorted in one run.
+    auto input = make_input(500);
+    csvm::CSVSorter(input_path, output_path, {"key"}, "|").sort();
+    check_sorted(input, "CSVSorter doesn't sort a file in memory properly.");
+}
+
+
+void test_sort_with_runs() {
+    // A small memory budget should make many runs, which are merged stably.
+    auto input = make_input(5000);
+    csvm::CSVSorter(input_path, output_path, {"key"}, "|", '"', 16 << 10, current_dir + "/assets", 3).sort();
+    check_sorted(input, "CSVSorter doesn't merge runs properly.");
+
+    for (auto& i : std::filesystem::directory_iterator(current_dir + "/assets"))
+        if (i.path().filename().string().find("csvm_sort_") == 0)
+            throw std::logic_error("CSVSorter doesn't delete temporary files.");
+}
+
+
+void test_invalid_key() {
+    // Non-existing key columns should be rejected.
+    make_input(10);
+
+    bool bad = true;
+    try {csvm::CSVSorter(input_path, output_path, {"missing"}, "|").sort();} catch (std::invalid_argument) {bad = false;}
+
+    if (bad)
+        throw std::logic_error("CSVSorter takes a non-existing key column.");
+}
+
+
+int main() {
+
+    test_sort_in_memory();
+
+    test_sort_with_runs();
+
+    test_invalid_key();
+
+    std::filesystem::remove(input_path);
+    std::filesystem::remove(output_path);
+
+    return 0;
+}
@@ -0,0 +1,52 @@
+// Tests for csv_thread_pool.hpp.
+
+
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <stdexcept>
+
+#include "../csv_thread_pool.hpp"
+
+
+void test_submit() {
+    // Tasks should return their results through futures.
+    csvm::CSVThreadPool pool(3);
+
+    std::vector<std::future<int>> results;
+    for (int i = 0; i < 100; ++i)
+        results.push_back(pool.submit([i]() {return i * i;}));
+
+    for (int i = 0; i < 100; ++i)
+        if (results[i].get() != i * i)
+            throw std::logic_error("CSVThreadPool returns wrong results.");
+}
+
+
+void test_for_each() {
+    // .for_each() should call the function for every index and pass exceptions.
+    csvm::CSVThreadPool pool(4);
+    std::vector<std::atomic<int>> calls(1000);
+
+    pool.for_each(calls.size(), [&calls](std::size_t i) {++calls[i];});
+    for (auto& i : calls)
+        if (i != 1)
+            throw std::logic_error(".for_each() doesn't call the function once for every index.");
+
+    bool bad = true;
+    try {pool.for_each(10, [](std::size_t i) {if (i == 7) throw std::runtime_error("Task error.");});}
+    catch (std::runtime_error) {bad = false;}
+
+    if (bad)
+        throw std::logic_error(".for_each() doesn't pass exceptions.");
+}
+
+
+int main() {
+
+    test_submit();
+
+    test_for_each();
+
+    return 0;
+}
@@ -0,0 +1,144 @@
+// Tests for csv_transcoder.hpp
+
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <filesystem>
+
+#include "../csv_transcoder.hpp"
+#include "../csv_encoder.hpp"
+#include "../csv_sink.hpp"
+
+
+using vector_s = std::vector<std::string>;
+using vector_v_s = std::vector<vector_s>;
+
+
+std::string file_path = __FILE__;
+std::string current_dir = file_path.substr(0, file_path.find_last_of("/\\"));
+
+
+std::string encode(vector_v_s& rows, const std::string& delimiter, char quote, const std::string& line_end = "\n") {
+    // Encodes rows with CSVEncoder.
+    csvm::CSVBufferSink output;
+    csvm::CSVEncoder<vector_v_s::iterator>(rows.begin(), rows.end(), delimiter, quote).encode_all(output, line_end);
+    return output.buffer;
+}
+
+
+std::string transcode(csvm::CSVTranscoder& transcoder, const std::string& input) {
+    csvm::CSVBufferSink output;
+    transcoder.transcode(input, output);
+    return output.buffer;
+}
+
+
+vector_v_s sample_rows() {
+    // Fields which are special in some of the tested dialects.
+    vector_v_s rows = {{"plain", "", "12.5", "with space"}, {"a,b", "a;b", "a<|>b", "a<|b"}, {"q\"x", "q'x", "\"\"", "''"},
+                       {"line\nfeed", "carriage\rreturn", "end\r", "\r\n"}, {"", "", "", ""}, {"<|>", "<", "|>", ","}};
+    for (std::size_t i = 0; i < 200; ++i)
+        rows.push_back({std::string(i, 'x') + (i % 3 ? "," : "\""), std::to_string(i), std::string(i % 40, ';'), "tail"});
+    return rows;
+}
+
+
+void test_dialects() {
+    // Transcoding text of one dialect should give what CSVEncoder writes in the other one.
+    auto rows = sample_rows();
+    std::vector<std::pair<std::string, char>> dialects = {{",", '"'}, {";", '\''}, {"<|>", '"'}, {"\t", '|'}, {",", '\''}};
+
+    for (auto& from : dialects)
+        for (auto& to : dialects) {
+            if (to.first.find(to.second) != std::string::npos || from.first.find(from.second) != std::string::npos)
+                continue;
+            csvm::CSVTranscoder transcoder(from.first, from.second, to.first, to.second);
+            auto output = transcode(transcoder, encode(rows, from.first, from.second));
+            if (output != encode(rows, to.first, to.second))
+                throw std::logic_error("CSVTranscoder doesn't transcode from \"" + from.first + "\" to \"" + to.first + "\".");
+            if (transcoder.stats().rows != rows.size() || transcoder.stats().fields != rows.size() * 4)
+                throw std::logic_error("CSVTranscoder doesn't count rows and fields.");
+        }
+}
+
+
+void test_passthrough() {
+    // Fields which don't change should be copied, and the same dialect should give the same text.
+    auto rows = sample_rows();
+    auto input = encode(rows, ",", '"');
+
+    csvm::CSVTranscoder same;
+    if (transcode(same, input) != input || same.stats().copied_fields != same.stats().fields)
+        throw std::logic_error("CSVTranscoder doesn't copy fields of the same dialect.");
+
+    vector_v_s plain = {{"a", "b", "c"}, {"d", "e", "f"}};
+    csvm::CSVTranscoder other(",", '"', "\t", '\'');
+    if (transcode(other, encode(plain, ",", '"')) != "a\tb\tc\nd\te\tf\n" || other.stats().copied_fields != 6)
+        throw std::logic_error("CSVTranscoder doesn't copy unchanged fields.");
+}
+
+
+void test_lenient_input() {
+    // CRLF line ends, text after closing quotes, unnecessary quotes, unclosed quotes and a missing last line end.
+    csvm::CSVTranscoder transcoder(",", '"', ";", '"', "\r\n");
+    std::string input = "a,b\r\n\"x\"y,\"p\"\"q\"\r\n\"c\",\"d;e\"\n\nlast,\"open\nquote";
+    std::string target = "a;b\r\nxy;\"p\"\"q\"\r\nc;\"d;e\"\r\n\r\nlast;\"open\nquote\"\r\n";
+
+    auto output = transcode(transcoder, input);
+    if (output != target)
+        throw std::logic_error("CSVTranscoder doesn't handle lenient input: " + output);
+    if (transcode(transcoder, "") != "")
+        throw std::logic_error("CSVTranscoder doesn't handle empty input.");
+
+    bool raised = false;
+    try {
+        csvm::CSVTranscoder(",", '"', ",\"", '"');
+    }
+    catch (const std::invalid_argument&) {
+        raised = true;
+    }
+    if (!raised)
+        throw std::logic_error("CSVTranscoder doesn't check dialects.");
+}
+
+
+void test_transcode_file() {
+    // Files should be mapped and transcoded, including empty ones.
+    std::string input = current_dir + "/assets/transcoder_1.csv", output = current_dir + "/assets/transcoder_2.csv";
+    auto rows = sample_rows();
+    std::ofstream(input, std::ios::binary) << encode(rows, ",", '"');
+
+    csvm::CSVTranscoder transcoder(",", '"', "|", '\'');
+    if (transcoder.transcode_file(input, output, 64) != rows.size())
+        throw std::logic_error("CSVTranscoder::transcode_file() doesn't return the number of rows.");
+
+    std::stringstream content;
+    content << std::ifstream(output, std::ios::binary).rdbuf();
+    if (content.str() != encode(rows, "|", '\''))
+        throw std::logic_error("CSVTranscoder::transcode_file() doesn't transcode the file.");
+
+    std::ofstream(input, std::ios::trunc);
+    if (transcoder.transcode_file(input, output) != 0 || std::filesystem::file_size(output) != 0)
+        throw std::logic_error("CSVTranscoder::transcode_file() doesn't handle empty files.");
+
+    std::filesystem::remove(input);
+    std::filesystem::remove(output);
+}
+
+
+int main() {
+
+    test_dialects();
+
+    test_passthrough();
+
+    test_lenient_input();
+
+    test_transcode_file();
+
+    return 0;
+}
@@ -4,6 +4,9 @@
 #include <string>
 #include <stdexcept>
 #include <cassert>
+#include <filesystem>
+#include <iterator>
+#include <sstream>
 
 #include "../csv_writer.hpp"
 #include "../csv_reader.hpp"
@@ -38,9 +41,271 @@ void test_write_all_1() {
 }
 
 
+void test_write_batch() {
+    // Batches from the reader should be written one after another.
+    std::string path = current_dir + "/assets/written_2.csv";
+
+    csvm::CSVData header, batch, output, target;
+    csvm::CSVReader reader(header, current_dir + "/assets/file_3.csv", "|");
+    csvm::CSVWriter writer(header, path, ",");
+
+    while (reader.read_batch(batch, 3))
+        writer.write_batch(batch);
+    writer.close();
+
+    csvm::CSVReader(output, path).read_all();
+    csvm::CSVReader(target, current_dir + "/assets/file_3.csv", "|").read_all();
+    std::filesystem::remove(path);
+
+    if (output != target || output.get_column_names() != target.get_column_names())
+        throw std::logic_error("The data written by batches isn't the same as the input data.");
+}
+
+
+void test_write_all_parallel() {
+    // Blocks encoded in parallel should be written in the right order.
+    std::string path = current_dir + "/assets/written_4.csv";
+
+    csvm::CSVData data, output;
+    data.add_column("number").add_column("text");
+    for (int i = 0; i < 10000; ++i)
+        data.add_row({std::to_string(i), i % 7 ? "plain" : "with,comma"});
+
+    csvm::CSVWriter(data, path).write_all_parallel(4, 100);
+    csvm::CSVReader(output, path).read_all();
+    std::filesystem::remove(path);
+
+    if (output != data || output.get_column_names() != data.get_column_names())
+        throw std::logic_error("The data written in parallel isn't the same as the input data.");
+
+    // A table without rows should be written as the header alone.
+    csvm::CSVData empty;
+    empty.add_column("only");
+    csvm::CSVWriter(empty, path).write_all_parallel();
+    csvm::CSVReader(output, path).read_all();
+    std::filesystem::remove(path);
+
+    if (output.row_number() != 0 || output.get_column_names() != vector_s{"only"})
+        throw std::logic_error("An empty table isn't written properly in parallel.");
+}
+
+
+void test_write_all_quoting() {
+    // Rows should be quoted by the chosen policy, and read back unchanged.
+    std::string path = current_dir + "/assets/written_5.csv";
+
+    csvm::CSVData data, output;
+    data.add_column("number").add_column("text");
+    data.add_row({{"1.5", "a"}, {"-2", "b,c"}});
+
+    csvm::CSVWriter(data, path).write_all<csvm::QuoteNonNumeric>();
+
+    std::ifstream file(path);
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+
+    csvm::CSVReader(output, path).read_all();
+    std::filesystem::remove(path);
+
+    if (content != "number,text\n1.5,\"a\"\n-2,\"b,c\"\n")
+        throw std::logic_error("Rows aren't quoted by the policy.");
+    if (output != data)
+        throw std::logic_error("The data quoted by the policy isn't the same as the input data.");
+}
+
+
+void test_buffer_and_sync() {
+    // Rows should be written by few big system calls, and the file should be synced on close by the policy.
+    std::string path = current_dir + "/assets/written_6.csv";
+
+    csvm::CSVData data, output;
+    data.add_column("number");
+    for (int i = 0; i < 1000; ++i)
+        data.add_row({std::to_string(i)});
+
+    csvm::CSVWriter writer(data, path, ",", '"', false, 1024, csvm::CSVWriter::Sync::on_close);
+    writer.write_batch(data);
+    if (writer.stats().syscalls == 0 || writer.stats().syscalls > 4 || writer.stats().syncs != 0)
+        throw std::logic_error("The writer doesn't write by big pieces.");
+
+    writer.flush().close();
+    csvm::CSVReader(output, path).read_all();
+    std::filesystem::remove(path);
+
+    if (writer.stats().bytes != std::string(data).size() || writer.stats().syncs != 1)
+        throw std::logic_error("The writer doesn't count written bytes or doesn't sync on close.");
+    if (output != data)
+        throw std::logic_error("The data written through the big buffer isn't the same as the input data.");
+}
+
+
+void test_asynchronous() {
+    // The asynchronous writer should write everything once it's complete, by both write_all and batches.
+    std::string path = current_dir + "/assets/written_7.csv";
+
+    csvm::CSVData data, output;
+    data.add_column("number").add_column("text");
+    for (int i = 0; i < 5000; ++i)
+        data.add_row({std::to_string(i), i % 3 ? "plain" : "with,comma"});
+
+    csvm::CSVWriter writer(data, path, ",", '"', false, 1024, csvm::CSVWriter::Sync::never, 0, 3);
+    writer.write_all().await_complete();
+    csvm::CSVReader(output, path).read_all();
+
+    if (output != data || writer.stats().bytes != std::string(data).size() || writer.stats().syscalls < 2)
+        throw std::logic_error("The asynchronous writer doesn't write all the data.");
+
+    {
+        csvm::CSVWriter batches(data, path, ",", '"', false, 4096, csvm::CSVWriter::Sync::on_close, 0, 2);
+        batches.write_batch(data).write_batch(data).flush();
+    }
+    csvm::CSVReader(output, path).read_all();
+    std::filesystem::remove(path);
+
+    if (output.row_number() != data.row_number() * 2)
+        throw std::logic_error("The asynchronous writer doesn't write batches.");
+}
+
+
+void test_append() {
+    // Only new and changed rows should be written into the existing file, after its checked header.
+    std::string path = current_dir + "/assets/written_8.csv";
+
+    csvm::CSVData data, output;
+    data.add_column("id").add_column("text");
+    for (int i = 0; i < 100; ++i)
+        data.add_row({std::to_string(i), i % 5 ? "plain" : "say \"hi\", then go"});
+    csvm::CSVWriter(data, path).write_all();
+
+    csvm::CSVData read;
+    csvm::CSVReader(read, path).read_all();
+    read.add_row({{"100", "new"}, {"101", "new,er"}});
+    csvm::CSVWriter appended(read, path, ",", '"', true);
+    appended.write_all();
+
+    csvm::CSVReader(output, path).read_all();
+    if (output != read || appended.stats().bytes != std::string("100,new\n101,\"new,er\"\n").size())
+        throw std::logic_error("The append mode doesn't write only new rows.");
+
+    read.get_values()[50][1] = "changed";
+    read.mark_dirty(50);
+    read.add_row({"102", "newest"});
+    csvm::CSVWriter(read, path, ",", '"', true).write_all_parallel(2, 7);
+    if (read.is_dirty())
+        throw std::logic_error("Written data is still dirty.");
+
+    csvm::CSVReader(output, path).read_all();
+    if (output != read)
+        throw std::logic_error("The append mode doesn't rewrite the file from the first dirty row.");
+
+    csvm::CSVData other;
+    other.add_column("id");
+    try {
+        csvm::CSVWriter(other, path, ",", '"', true);
+        throw std::logic_error("The append mode doesn't check the header.");
+    }
+    catch (std::invalid_argument&) {}
+    std::filesystem::remove(path);
+
+    // A new file gets the header.
+    csvm::CSVWriter(other.add_row({"1"}), path, ",", '"', true).write_all();
+    csvm::CSVReader(output, path).read_all();
+    std::filesystem::remove(path);
+
+    if (output != other || output.get_column_names() != vector_s{"id"})
+        throw std::logic_error("The append mode doesn't write the header into a new file.");
+}
+
+
+void test_append_unquoted() {
+    // Quotes inside fields written without quoting shouldn't hide line ends when the file is cut at the first dirty row.
+    std::string path = current_dir + "/assets/written_12.csv";
+
+    for (int stray : {1, 2}) {
+        csvm::CSVData data, output;
+        data.add_column("id").add_column("text");
+        for (int i = 0; i < 10; ++i)
+            data.add_row({std::to_string(i), i < stray ? "5\" screw" : "y"});
+        csvm::CSVWriter(data, path).write_all<csvm::QuoteNever>();
+
+        data.get_values()[4][1] = "CHANGED";
+        data.mark_dirty(4);
+        csvm::CSVWriter(data, path, ",", '"', true).write_all<csvm::QuoteNever>();
+
+        std::stringstream content;
+        content << std::ifstream(path).rdbuf();
+        std::string target = "id,text\n";
+        for (int i = 0; i < 10; ++i)
+            target += std::to_string(i) + "," + (i < stray ? "5\" screw" : i == 4 ? "CHANGED" : "y") + "\n";
+        if (content.str() != target)
+            throw std::logic_error("The append mode doesn't find rows with quotes inside fields.");
+    }
+    std::filesystem::remove(path);
+}
+
+
+void test_write_all_mapped() {
+    // Blocks encoded straight into the mapped file should give the same file as the sequential writer.
+    std::string path = current_dir + "/assets/written_10.csv", sequential_path = current_dir + "/assets/written_11.csv";
+
+    csvm::CSVData data;
+    data.add_column("number").add_column("text");
+    for (int i = 0; i < 20000; ++i)
+        data.add_row({std::to_string(i), i % 7 ? "plain" : "with \"quotes\", and comma"});
+
+    csvm::CSVWriter(data, path).write_all_mapped(4, 333);
+    csvm::CSVWriter(data, sequential_path).write_all();
+
+    std::stringstream mapped, sequential;
+    mapped << std::ifstream(path).rdbuf();
+    sequential << std::ifstream(sequential_path).rdbuf();
+    std::filesystem::remove(sequential_path);
+
+    if (mapped.str() != sequential.str())
+        throw std::logic_error("The mapped file isn't the same as the sequentially written one.");
+
+    // Only dirty rows should be rewritten in the append mode.
+    data.get_values()[10000][1] = "changed";
+    data.mark_dirty(10000);
+    data.add_row({"new", "row"});
+    csvm::CSVWriter(data, path, ",", '"', true).write_all_mapped(3, 1000);
+
+    csvm::CSVData output;
+    csvm::CSVReader(output, path).read_all();
+    if (output != data)
+        throw std::logic_error("The mapped writer doesn't rewrite dirty rows in the append mode.");
+
+    // A table without rows should be written as the header alone.
+    csvm::CSVData empty;
+    empty.add_column("only");
+    csvm::CSVWriter(empty, path).write_all_mapped();
+    csvm::CSVReader(output, path).read_all();
+    std::filesystem::remove(path);
+
+    if (output.row_number() != 0 || output.get_column_names() != vector_s{"only"})
+        throw std::logic_error("An empty table isn't written properly by the mapped writer.");
+}
+
+
 int main() {
 
     test_write_all_1();
 
+    test_write_batch();
+
+    test_write_all_parallel();
+
+    test_write_all_quoting();
+
+    test_buffer_and_sync();
+
+    test_asynchronous();
+
+    test_append();
+
+    test_append_unquoted();
+
+    test_write_all_mapped();
+
     return 0;
 }